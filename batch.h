@@ -0,0 +1,165 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "symbols.h"
+#include "vm.h"
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MINICOMPILER_SIMD 1
+#include <immintrin.h>
+#endif
+
+using ColumnKernel = void (*)(double* dst, const double* a, const double* b, size_t n);
+
+#define COLUMN_KERNEL_SCALAR(name, expr) \
+    inline void name(double* dst, const double* a, const double* b, size_t n) { \
+        for (size_t i = 0; i < n; i++) dst[i] = a[i] expr b[i]; \
+    }
+
+COLUMN_KERNEL_SCALAR(addScalar, +)
+COLUMN_KERNEL_SCALAR(subScalar, -)
+COLUMN_KERNEL_SCALAR(mulScalar, *)
+COLUMN_KERNEL_SCALAR(divScalar, /)
+
+#ifdef MINICOMPILER_SIMD
+#define COLUMN_KERNEL_SIMD(name, isa, width, type, load, store, op, expr) \
+    __attribute__((target(isa))) inline void name(double* dst, const double* a, const double* b, size_t n) { \
+        size_t i = 0; \
+        for (; i + width <= n; i += width) { \
+            type x = load(a + i); \
+            type y = load(b + i); \
+            store(dst + i, op(x, y)); \
+        } \
+        for (; i < n; i++) dst[i] = a[i] expr b[i]; \
+    }
+
+COLUMN_KERNEL_SIMD(addAvx2, "avx2", 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, +)
+COLUMN_KERNEL_SIMD(subAvx2, "avx2", 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd, -)
+COLUMN_KERNEL_SIMD(mulAvx2, "avx2", 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd, *)
+COLUMN_KERNEL_SIMD(divAvx2, "avx2", 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd, /)
+COLUMN_KERNEL_SIMD(addSse2, "sse2", 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, +)
+COLUMN_KERNEL_SIMD(subSse2, "sse2", 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd, -)
+COLUMN_KERNEL_SIMD(mulSse2, "sse2", 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd, *)
+COLUMN_KERNEL_SIMD(divSse2, "sse2", 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd, /)
+
+__attribute__((target("avx2"))) inline bool hasZeroAvx2(const double* b, size_t n) {
+    __m256d zero = _mm256_setzero_pd();
+    __m256d found = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        found = _mm256_or_pd(found, _mm256_cmp_pd(_mm256_loadu_pd(b + i), zero, _CMP_EQ_OQ));
+    }
+    bool result = _mm256_movemask_pd(found) != 0;
+    for (; i < n; i++) result |= b[i] == 0;
+    return result;
+}
+#endif
+
+inline bool hasZeroScalar(const double* b, size_t n) {
+    bool result = false;
+    for (size_t i = 0; i < n; i++) result |= b[i] == 0;
+    return result;
+}
+
+struct ColumnKernels {
+    ColumnKernel add, sub, mul, div;
+    bool (*hasZero)(const double* b, size_t n);
+    
+    static ColumnKernels select() {
+#ifdef MINICOMPILER_SIMD
+        if (__builtin_cpu_supports("avx2")) return {addAvx2, subAvx2, mulAvx2, divAvx2, hasZeroAvx2};
+        return {addSse2, subSse2, mulSse2, divSse2, hasZeroScalar};
+#else
+        return {addScalar, subScalar, mulScalar, divScalar, hasZeroScalar};
+#endif
+    }
+};
+
+struct BatchResult {
+    std::unordered_map<std::string, std::vector<double>> variables;
+    std::vector<std::vector<double>> prints;
+};
+
+// Evaluates a compiled Program over N rows at once: every slot becomes a
+// column and each bytecode instruction runs as one vector kernel per block.
+class BatchEvaluator {
+private:
+    const Program& program;
+    const Interner& symbols;
+    ColumnKernels kernels;
+    std::vector<const double*> inputs;
+    size_t blockSize;
+    
+public:
+    BatchEvaluator(const Program& prog, const Interner& interner, size_t block = 1024)
+        : program(prog), symbols(interner), kernels(ColumnKernels::select()),
+          inputs(prog.variableCount, nullptr), blockSize(block) {}
+    
+    void bind(const std::string& name, const double* column) {
+        SymbolId id;
+        if (!symbols.find(name, id) || id >= program.variableCount) {
+            throw std::runtime_error("Error batch: variable '" + name + "' no existe en el programa");
+        }
+        inputs[id] = column;
+    }
+    
+    BatchResult evaluate(size_t rows) {
+        BatchResult result;
+        std::vector<Slot> assigned;
+        std::vector<bool> written(program.variableCount, false);
+        for (const Bytecode& inst : program.code) {
+            if (inst.op == OpCode::PRINT || inst.dst < 0 || written[inst.dst]) continue;
+            written[inst.dst] = true;
+            assigned.push_back(inst.dst);
+        }
+        for (Slot slot : assigned) result.variables[std::string(symbols.name(slot))].resize(rows);
+        size_t printCount = 0;
+        for (const Bytecode& inst : program.code) printCount += inst.op == OpCode::PRINT;
+        result.prints.assign(printCount, std::vector<double>(rows));
+        
+        size_t slotCount = static_cast<size_t>(program.registerCount()) + program.variableCount;
+        std::vector<double> columns(slotCount * blockSize, 0.0);
+        auto column = [&](Slot slot) {
+            return columns.data() + static_cast<size_t>(slot + static_cast<Slot>(program.registerCount())) * blockSize;
+        };
+        for (size_t start = 0; start < rows; start += blockSize) {
+            size_t n = std::min(blockSize, rows - start);
+            // Unbound variables start every row at 0, as in a fresh VM frame,
+            // instead of keeping the previous block's values.
+            for (SymbolId id = 0; id < program.variableCount; id++) {
+                double* values = column(static_cast<Slot>(id));
+                if (inputs[id]) std::memcpy(values, inputs[id] + start, n * sizeof(double));
+                else std::fill(values, values + n, 0.0);
+            }
+            size_t printIndex = 0;
+            for (const Bytecode& inst : program.code) {
+                switch (inst.op) {
+                    case OpCode::MOVE:
+                        std::memmove(column(inst.dst), column(inst.a), n * sizeof(double));
+                        break;
+                    case OpCode::ADD: kernels.add(column(inst.dst), column(inst.a), column(inst.b), n); break;
+                    case OpCode::SUB: kernels.sub(column(inst.dst), column(inst.a), column(inst.b), n); break;
+                    case OpCode::MUL: kernels.mul(column(inst.dst), column(inst.a), column(inst.b), n); break;
+                    case OpCode::DIV:
+                        if (kernels.hasZero(column(inst.b), n)) throw std::runtime_error("Division por cero");
+                        kernels.div(column(inst.dst), column(inst.a), column(inst.b), n);
+                        break;
+                    case OpCode::PRINT:
+                        std::memcpy(result.prints[printIndex++].data() + start, column(inst.a), n * sizeof(double));
+                        break;
+                    case OpCode::LOAD:
+                        std::fill(column(inst.dst), column(inst.dst) + n, immediate(inst));
+                        break;
+                }
+            }
+            for (Slot slot : assigned) {
+                std::memcpy(result.variables[std::string(symbols.name(slot))].data() + start, column(slot), n * sizeof(double));
+            }
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+// Compiler benchmark: g++ -std=c++17 -O2 -o bench bench.cpp
+// ./bench [--statements N] [--depth D] [--variables V] [--seed S] [--repeat R]
+// Prints one JSON object per run on stdout.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "repl.h"
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocationBytes{0};
+
+}
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    allocatedBytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+// noinline as in repl.cpp: it keeps -Wmismatched-new-delete quiet.
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct BenchConfig {
+    size_t statements = 20000;
+    int depth = 6;
+    int variables = 64;
+    uint32_t seed = 42;
+    int repeat = 5;
+};
+
+// Random programs that always pass semantic analysis and never divide by
+// zero: variables are assigned before use and divisors are non-zero literals.
+class ProgramGenerator {
+private:
+    std::mt19937 rng;
+    const BenchConfig& config;
+    int defined;
+    
+    std::string literal() {
+        std::string value = std::to_string(rng() % 100 + 1);
+        if (rng() % 4 == 0) value += "." + std::to_string(rng() % 10);
+        return value;
+    }
+    
+    std::string operand() {
+        if (defined > 0 && rng() % 2) return "v" + std::to_string(rng() % defined);
+        return literal();
+    }
+    
+    std::string expression(int depth) {
+        if (depth == 0 || rng() % 4 == 0) return operand();
+        const char ops[] = "+-*/";
+        char op = ops[rng() % 4];
+        std::string right = op == '/' ? literal() : expression(depth - 1);
+        return "(" + expression(depth - 1) + " " + op + " " + right + ")";
+    }
+    
+public:
+    ProgramGenerator(const BenchConfig& cfg) : rng(cfg.seed), config(cfg), defined(0) {}
+    
+    std::vector<std::string> generate() {
+        std::vector<std::string> lines;
+        lines.reserve(config.statements);
+        for (size_t i = 0; i < config.statements; i++) {
+            if (defined > 0 && rng() % 10 == 0) {
+                lines.push_back("print(" + expression(config.depth) + ");");
+                continue;
+            }
+            int target = defined < config.variables ? defined : static_cast<int>(rng() % config.variables);
+            lines.push_back("v" + std::to_string(target) + " = " + expression(config.depth) + ";");
+            defined = std::max(defined, target + 1);
+        }
+        return lines;
+    }
+};
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct PhaseResult {
+    std::string name;
+    std::string unit;
+    double items = 0;
+    std::vector<double> seconds;
+    // Summed over every repeat; reported per run.
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    
+    PhaseResult(const char* phase, const char* measure) : name(phase), unit(measure) {}
+};
+
+class Timer {
+private:
+    PhaseResult& phase;
+    std::chrono::steady_clock::time_point start;
+    uint64_t count, bytes;
+    
+public:
+    explicit Timer(PhaseResult& result)
+        : phase(result), start(std::chrono::steady_clock::now()),
+          count(allocationCount.load()), bytes(allocationBytes.load()) {}
+    
+    ~Timer() {
+        auto end = std::chrono::steady_clock::now();
+        phase.seconds.push_back(std::chrono::duration<double>(end - start).count());
+        phase.allocations += allocationCount.load() - count;
+        phase.bytes += allocationBytes.load() - bytes;
+    }
+};
+
+void printJson(const BenchConfig& config, size_t sourceBytes, const std::vector<PhaseResult>& phases) {
+    std::ostringstream out;
+    out.precision(6);
+    out << "{\"version\":2,\"config\":{\"statements\":" << config.statements << ",\"depth\":" << config.depth
+        << ",\"variables\":" << config.variables << ",\"seed\":" << config.seed << ",\"repeat\":" << config.repeat
+        << ",\"source_bytes\":" << sourceBytes << "},\"phases\":[";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const PhaseResult& p = phases[i];
+        std::vector<double> sorted = p.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        double best = sorted.front();
+        double median = sorted[sorted.size() / 2];
+        uint64_t runs = p.seconds.size();
+        out << (i ? "," : "") << "{\"name\":\"" << p.name << "\",\"best_s\":" << best << ",\"median_s\":" << median
+            << ",\"" << p.unit << "\":" << p.items << ",\"" << p.unit << "_per_s\":" << (best > 0 ? p.items / best : 0)
+            << ",\"allocations\":" << p.allocations / runs << ",\"allocated_bytes\":" << p.bytes / runs << "}";
+    }
+    out << "]}\n";
+    std::cout << out.str();
+}
+
+bool parseArguments(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        char* end = nullptr;
+        errno = 0;
+        long value = std::strtol(argv[i + 1], &end, 10);
+        if (end == argv[i + 1] || *end != '\0' || errno == ERANGE || value < 0) return false;
+        // Any seed is valid; every other setting must be at least 1.
+        if (value == 0 && flag != "--seed") return false;
+        if (flag == "--statements") config.statements = static_cast<size_t>(value);
+        else if (flag == "--depth") config.depth = static_cast<int>(value);
+        else if (flag == "--variables") config.variables = static_cast<int>(value);
+        else if (flag == "--seed") config.seed = static_cast<uint32_t>(value);
+        else if (flag == "--repeat") config.repeat = static_cast<int>(value);
+        else return false;
+    }
+    return argc % 2 == 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArguments(argc, argv, config)) {
+        std::cerr << "Uso: " << argv[0] << " [--statements N] [--depth D] [--variables V] [--seed S] [--repeat R]\n";
+        return 2;
+    }
+    std::vector<std::string> lines = ProgramGenerator(config).generate();
+    std::string source;
+    for (const std::string& line : lines) source += line + "\n";
+    
+    std::vector<PhaseResult> phases = {
+        {"lexer", "tokens"}, {"parser", "statements"}, {"semantic", "statements"},
+        {"codegen", "instructions"}, {"vm", "instructions"}, {"jit_compile", "instructions"},
+        {"jit", "instructions"}, {"repl", "statements"}
+    };
+    NullBuffer null;
+    std::streambuf* stdoutBuffer = std::cout.rdbuf();
+    try {
+        for (int r = 0; r < config.repeat; r++) {
+            Interner symbols;
+            std::vector<TokenView> tokens;
+            {
+                Timer timer(phases[0]);
+                Lexer lexer(source, symbols);
+                tokens = lexer.scan();
+            }
+            phases[0].items = static_cast<double>(tokens.size());
+            Ast statements(&symbols);
+            {
+                Timer timer(phases[1]);
+                Parser parser(source, std::move(tokens), symbols);
+                statements = parser.parse();
+            }
+            phases[1].items = static_cast<double>(statements.getStatements().size());
+            SemanticAnalyzer semantic(symbols);
+            {
+                Timer timer(phases[2]);
+                semantic.analyze(statements);
+            }
+            phases[2].items = phases[1].items;
+            CodeGenerator codegen(symbols);
+            VM vm;
+            {
+                Timer timer(phases[3]);
+                codegen.generate(statements);
+            }
+            phases[3].items = static_cast<double>(codegen.getInstructions().size());
+            const Program& program = codegen.getProgram();
+            phases[4].items = phases[5].items = phases[6].items = static_cast<double>(program.code.size());
+            std::cout.rdbuf(&null);
+            {
+                Timer timer(phases[4]);
+                codegen.execute(vm);
+            }
+            // Compiling is timed on its own, so "jit" counts only the run and
+            // compares with "vm".
+            if (JitFunction::supported()) {
+                JitFunction native;
+                {
+                    Timer timer(phases[5]);
+                    native.compile(program);
+                }
+                Timer timer(phases[6]);
+                vm.reset();
+                native.run(vm.prepare(program), vm.printer(), vm.printerContext());
+            }
+            {
+                REPL repl;
+                Timer timer(phases[7]);
+                for (const std::string& line : lines) repl.evaluateLine(line);
+            }
+            std::cout.rdbuf(stdoutBuffer);
+            phases[7].items = static_cast<double>(lines.size());
+        }
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(stdoutBuffer);
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (!JitFunction::supported()) phases.erase(phases.begin() + 5, phases.begin() + 7);
+    printJson(config, source.size(), phases);
+    return 0;
+}
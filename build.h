@@ -0,0 +1,74 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+#include "driver.h"
+#include "work_stealing.h"
+#include <algorithm>
+#include <thread>
+
+struct BuildDiagnostic {
+    std::string path;
+    std::string message;
+};
+
+struct BuildReport {
+    size_t compiled = 0;
+    size_t upToDate = 0;
+    std::vector<BuildDiagnostic> diagnostics;
+};
+
+// Compiles many scripts into one cache directory, one image per distinct
+// source. Every file gets a BatchDriver of its own, so workers share nothing
+// but the queue; each writes only its files' results, which are merged and
+// sorted by path once all workers are done.
+class ParallelBuilder {
+private:
+    struct Outcome {
+        bool built = false;
+        std::string error;
+    };
+    
+    std::string directory;
+    unsigned threads;
+    
+public:
+    // `threadCount` 0 uses every hardware thread.
+    explicit ParallelBuilder(const std::string& cacheDirectory, unsigned threadCount = 0)
+        : directory(cacheDirectory), threads(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency())) {}
+    
+    BuildReport build(const std::vector<std::string>& paths) const {
+        WorkStealingQueue<size_t> queue(threads);
+        for (size_t i = 0; i < paths.size(); i++) queue.push(i, i);
+        std::vector<Outcome> outcomes(paths.size());
+        
+        auto work = [&](size_t worker) {
+            size_t index;
+            while (queue.pop(worker, index)) {
+                Outcome& outcome = outcomes[index];
+                try {
+                    BatchDriver driver;
+                    driver.setCache(directory);
+                    outcome.built = driver.buildFile(paths[index]);
+                } catch (const std::exception& e) {
+                    outcome.error = e.what();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        size_t started = std::min<size_t>(threads, paths.size());
+        for (size_t w = 0; w < started; w++) workers.emplace_back(work, w);
+        for (std::thread& worker : workers) worker.join();
+        
+        BuildReport report;
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (!outcomes[i].error.empty()) report.diagnostics.push_back({paths[i], std::move(outcomes[i].error)});
+            else if (outcomes[i].built) report.compiled++;
+            else report.upToDate++;
+        }
+        std::stable_sort(report.diagnostics.begin(), report.diagnostics.end(),
+                         [](const BuildDiagnostic& a, const BuildDiagnostic& b) { return a.path < b.path; });
+        return report;
+    }
+};
+
+#endif
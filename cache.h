@@ -0,0 +1,213 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "symbols.h"
+#include "vm.h"
+#include "mapped_file.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<Bytecode>::value && sizeof(Bytecode) == 16, "formato de Bytecode");
+
+// Image layout: header, bytecode, symbol name offsets and symbol text.
+// Sections start on 16-byte boundaries so the mapped image can be executed
+// in place.
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t registerCount;
+    uint32_t variableCount;
+    uint32_t symbolCount;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t codeOffset, codeCount;
+    uint64_t symbolOffset, textSize;
+};
+
+class CachedProgram {
+private:
+    MappedFile file;
+    const CacheHeader* header;
+    
+    template <typename T>
+    const T* section(uint64_t offset) const {
+        return reinterpret_cast<const T*>(file.view().data() + offset);
+    }
+    
+public:
+    explicit CachedProgram(const std::string& path) : file(path), header(nullptr) {}
+    
+    bool validate(uint64_t hash, uint64_t size, uint32_t version) {
+        std::string_view image = file.view();
+        if (image.size() < sizeof(CacheHeader)) return false;
+        const CacheHeader* h = reinterpret_cast<const CacheHeader*>(image.data());
+        if (std::memcmp(h->magic, "MCBCODE", 8) != 0 || h->version != version) return false;
+        if (h->sourceHash != hash || h->sourceSize != size) return false;
+        auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+            return offset % 16 == 0 && offset <= image.size() && count <= (image.size() - offset) / width;
+        };
+        if (!fits(h->codeOffset, h->codeCount, sizeof(Bytecode)) ||
+            !fits(h->symbolOffset, h->symbolCount + 1ull, sizeof(uint32_t)) ||
+            h->symbolOffset + (h->symbolCount + 1ull) * sizeof(uint32_t) + h->textSize > image.size()) {
+            return false;
+        }
+        
+        header = h;
+        int64_t low = -static_cast<int64_t>(h->registerCount);
+        int64_t high = h->variableCount;
+        auto valid = [&](Slot slot) { return slot >= low && slot < high; };
+        const Bytecode* code = section<Bytecode>(h->codeOffset);
+        for (uint64_t i = 0; i < h->codeCount; i++) {
+            const Bytecode& inst = code[i];
+            if (inst.op > OpCode::LOAD) return false;
+            if (inst.op != OpCode::PRINT && !valid(inst.dst)) return false;
+            if (inst.op == OpCode::LOAD) continue;
+            if (!valid(inst.a)) return false;
+            if (inst.op != OpCode::PRINT && inst.op != OpCode::MOVE && !valid(inst.b)) return false;
+        }
+        const uint32_t* offsets = section<uint32_t>(h->symbolOffset);
+        for (uint32_t i = 0; i < h->symbolCount; i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > h->textSize) return false;
+        }
+        return true;
+    }
+    
+    ProgramView view() const {
+        return {section<Bytecode>(header->codeOffset), static_cast<size_t>(header->codeCount),
+                header->registerCount, header->variableCount};
+    }
+    
+    uint32_t symbolCount() const {
+        return header->symbolCount;
+    }
+    
+    std::string_view symbolName(SymbolId id) const {
+        const uint32_t* offsets = section<uint32_t>(header->symbolOffset);
+        const char* text = reinterpret_cast<const char*>(offsets + header->symbolCount + 1);
+        return std::string_view(text + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+};
+
+// Writes an image while the program is still being generated: bytecode is
+// appended chunk by chunk and the header is filled in by finish(). The image
+// only becomes visible under its final name once it is complete.
+class CacheWriter {
+private:
+    std::string path, temporary;
+    std::ofstream out;
+    CacheHeader header;
+    bool finished;
+    
+    // Unique per writer, so threads building identical sources never
+    // share a temporary file.
+    static std::string temporaryPath(const std::string& target) {
+        static std::atomic<uint64_t> sequence{0};
+        return target + ".tmp." + std::to_string(getpid()) + "." + std::to_string(sequence++);
+    }
+    
+    void pad() {
+        static const char zeros[16] = {};
+        uint64_t position = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>((16 - position % 16) % 16));
+    }
+    
+public:
+    CacheWriter(const std::string& target, uint64_t hash, uint64_t size, uint32_t version)
+        : path(target), temporary(temporaryPath(target)), finished(false) {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "MCBCODE", 8);
+        header.version = version;
+        header.sourceHash = hash;
+        header.sourceSize = size;
+        out.open(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad();
+        header.codeOffset = static_cast<uint64_t>(out.tellp());
+    }
+    
+    ~CacheWriter() {
+        if (!finished) std::remove(temporary.c_str());
+    }
+    
+    CacheWriter(const CacheWriter&) = delete;
+    CacheWriter& operator=(const CacheWriter&) = delete;
+    
+    bool good() const {
+        return out.good();
+    }
+    
+    void append(const std::vector<Bytecode>& code) {
+        out.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(Bytecode)));
+        header.codeCount += code.size();
+    }
+    
+    bool finish(const Program& program, const Interner& symbols) {
+        header.registerCount = program.registerCount();
+        header.variableCount = program.variableCount;
+        pad();
+        
+        header.symbolOffset = static_cast<uint64_t>(out.tellp());
+        header.symbolCount = static_cast<uint32_t>(symbols.size());
+        std::vector<uint32_t> offsets{0};
+        std::string text;
+        for (SymbolId id = 0; id < symbols.size(); id++) {
+            text.append(symbols.name(id));
+            offsets.push_back(static_cast<uint32_t>(text.size()));
+        }
+        header.textSize = text.size();
+        out.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint32_t)));
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) return false;
+        finished = true;
+        return true;
+    }
+};
+
+// Directory of compiled images keyed by a hash of the source text. Bump
+// VERSION whenever the image layout or the generated code changes.
+class BytecodeCache {
+private:
+    std::string directory;
+    
+public:
+    static constexpr uint32_t VERSION = 3;
+    
+    explicit BytecodeCache(const std::string& dir) : directory(dir) {}
+    
+    static uint64_t key(std::string_view source) {
+        return fnv1a(source);
+    }
+    
+    std::string path(uint64_t hash) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.mcb", static_cast<unsigned long long>(hash));
+        return directory + "/" + name;
+    }
+    
+    std::unique_ptr<CachedProgram> load(uint64_t hash, uint64_t size) const {
+        std::string image = path(hash);
+        if (::access(image.c_str(), R_OK) != 0) return nullptr;
+        auto cached = std::make_unique<CachedProgram>(image);
+        if (!cached->validate(hash, size, VERSION)) return nullptr;
+        return cached;
+    }
+    
+    std::unique_ptr<CacheWriter> writer(uint64_t hash, uint64_t size) const {
+        if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return nullptr;
+        auto writer = std::make_unique<CacheWriter>(path(hash), hash, size, VERSION);
+        if (!writer->good()) return nullptr;
+        return writer;
+    }
+};
+
+#endif
@@ -0,0 +1,861 @@
+// Consistency checks: g++ -std=c++17 -O2 -o check check.cpp
+// ./check prints every failed check and exits with status 1 if any failed.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "codegen.h"
+#include "csv.h"
+#include "driver.h"
+#include "minicompiler.h"
+#include "parser.h"
+#include "repl.h"
+#include "server.h"
+#include "semantic.h"
+#include "static_program.h"
+
+MINICOMPILER_STATIC(StaticTotal, "precio, cantidad", "neto = precio * cantidad; total = neto * 1.21 - 0.5; print(total / 2);");
+MINICOMPILER_STATIC(StaticEmpty, "a", "");
+
+static_assert(StaticTotal::VARIABLES == 4 && StaticTotal::INPUTS == 2, "");
+static_assert(StaticTotal::variable("total") == 3, "");
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char* what) {
+    if (condition) return;
+    std::printf("FALLO: %s\n", what);
+    failures++;
+}
+
+struct Compiled {
+    Interner symbols;
+    Program program;
+};
+
+// The same steps as compile() in minicompiler.h, keeping the Program and
+// its symbols so they can be handed to the other evaluators.
+void compileInto(Compiled& out, std::string_view source, const std::vector<std::string>& inputs) {
+    SemanticAnalyzer semantic(out.symbols);
+    for (const std::string& name : inputs) semantic.declare(name);
+    Lexer lexer(source, out.symbols);
+    Parser parser(source, lexer.scan(), out.symbols);
+    Ast statements = parser.parse();
+    semantic.analyze(statements);
+    CodeGenerator codegen(out.symbols);
+    codegen.generate(statements);
+    out.program = codegen.getProgram();
+    out.program.variableCount = static_cast<uint32_t>(out.symbols.size());
+}
+
+// BatchEvaluator against one fresh VM per row. `b` is declared but left
+// unbound and is printed before it is assigned, so every row must see 0
+// there, not the value the previous block left in its column.
+void checkBatch() {
+    Compiled compiled;
+    compileInto(compiled, "c = a * 2 + b; print(c / 4); print(b); b = c - a; d = b * 0.5; print(d);", {"a", "b"});
+    const size_t rows = 2500;
+    std::vector<double> a(rows);
+    for (size_t i = 0; i < rows; i++) a[i] = static_cast<double>(i) * 0.37 - 100;
+    
+    BatchEvaluator batch(compiled.program, compiled.symbols, 1024);
+    batch.bind("a", a.data());
+    BatchResult result = batch.evaluate(rows);
+    SymbolId input = 0;
+    compiled.symbols.find("a", input);
+    
+    bool same = result.prints.size() == 3;
+    for (size_t i = 0; same && i < rows; i++) {
+        std::vector<double> printed;
+        VM vm;
+        vm.setPrinter([](void* context, double value) { static_cast<std::vector<double>*>(context)->push_back(value); }, &printed);
+        vm.prepare(compiled.program)[input] = a[i];
+        vm.run(compiled.program);
+        for (size_t p = 0; p < printed.size(); p++) same = same && result.prints[p][i] == printed[p];
+        for (const auto& [name, values] : result.variables) {
+            SymbolId id = 0;
+            compiled.symbols.find(name, id);
+            same = same && values[i] == vm.get(static_cast<Slot>(id));
+        }
+    }
+    expect(same, "BatchEvaluator coincide con la VM fila a fila");
+}
+
+// Random straight-line programs over a few variables. Subexpressions are
+// drawn from a small pool so that shared parsing keeps temps alive across
+// statements, and through the print calls between them; divisors may be 0.
+class RandomProgram {
+private:
+    std::mt19937 rng;
+    std::vector<std::string> pool;
+    std::vector<std::string> literals;
+    int defined = 0;
+    
+    std::string operand() {
+        if (defined > 0 && rng() % 3) return "v" + std::to_string(rng() % defined);
+        if (!literals.empty() && rng() % 3 == 0) return literals[rng() % literals.size()];
+        return std::to_string(rng() % 7) + (rng() % 2 ? ".5" : "");
+    }
+    
+    std::string expression(int depth) {
+        if (!pool.empty() && rng() % 3 == 0) return pool[rng() % pool.size()];
+        if (depth == 0) return operand();
+        std::string text = "(" + expression(depth - 1) + " " + "+-*/"[rng() % 4] + " " + expression(depth - 1) + ")";
+        if (pool.size() < 16) pool.push_back(text);
+        return text;
+    }
+    
+public:
+    // `extra` literals are drawn now and then in place of the small ones.
+    explicit RandomProgram(uint32_t seed, std::vector<std::string> extra = {}) : rng(seed), literals(std::move(extra)) {}
+    
+    std::string generate(int statements) {
+        std::string source;
+        for (int i = 0; i < statements; i++) {
+            if (defined > 0 && rng() % 3 == 0) {
+                source += "print(" + expression(3) + ");\n";
+                continue;
+            }
+            int target = static_cast<int>(rng() % 6);
+            if (target > defined) target = defined;
+            source += "v" + std::to_string(target) + " = " + expression(3) + ";\n";
+            // Reassigning a variable invalidates pooled text that reads it.
+            pool.clear();
+            defined = std::max(defined, target + 1);
+        }
+        return source;
+    }
+};
+
+struct Outcome {
+    std::vector<double> printed;
+    std::vector<double> variables;
+    std::string error;
+    
+    bool operator==(const Outcome& other) const {
+        auto same = [](const std::vector<double>& a, const std::vector<double>& b) {
+            if (a.size() != b.size()) return false;
+            return a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+        };
+        return same(printed, other.printed) && same(variables, other.variables) && error == other.error;
+    }
+};
+
+// Every xmm register is caller-saved, so a print callback may clobber the
+// ones holding temps; this one always does.
+void recordClobbering(void* context, double value) {
+    static_cast<std::vector<double>*>(context)->push_back(value);
+#ifdef MINICOMPILER_JIT
+    asm volatile("pxor %%xmm3, %%xmm3\n\tpxor %%xmm4, %%xmm4\n\tpxor %%xmm5, %%xmm5\n\tpxor %%xmm6, %%xmm6\n\t"
+                 "pxor %%xmm7, %%xmm7\n\tpxor %%xmm8, %%xmm8\n\tpxor %%xmm9, %%xmm9\n\tpxor %%xmm10, %%xmm10\n\t"
+                 "pxor %%xmm11, %%xmm11\n\tpxor %%xmm12, %%xmm12\n\tpxor %%xmm13, %%xmm13\n\tpxor %%xmm14, %%xmm14\n\t"
+                 "pxor %%xmm15, %%xmm15"
+                 ::: "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13",
+                     "xmm14", "xmm15");
+#endif
+}
+
+Outcome execute(CodeGenerator& codegen, const Interner& symbols) {
+    Outcome outcome;
+    VM vm;
+    vm.setPrinter(recordClobbering, &outcome.printed);
+    try {
+        codegen.execute(vm);
+    } catch (const std::runtime_error& e) {
+        outcome.error = e.what();
+    }
+    for (SymbolId id = 0; id < symbols.size(); id++) outcome.variables.push_back(vm.get(static_cast<Slot>(id)));
+    return outcome;
+}
+
+// The JIT must print and leave exactly what the VM does, with every temp in
+// memory, with fewer registers than live values (so temps spill), and with
+// shared temps held in xmm3-xmm15 across print calls, which preserve()
+// saves and restores.
+void checkJit() {
+    if (!JitFunction::supported()) return;
+    int mismatches = 0;
+    for (uint32_t seed = 1; seed <= 300; seed++) {
+        std::string source = RandomProgram(seed).generate(40);
+        for (uint32_t registers : {0u, 1u, 2u, 4u, 13u, 20u}) {
+            Interner symbols;
+            Lexer lexer(source, symbols);
+            Parser parser(source, lexer.scan(), symbols);
+            parser.shareExpressions(seed % 2 == 0);
+            Ast statements = parser.parse();
+            SemanticAnalyzer semantic(symbols);
+            semantic.analyze(statements);
+            CodeGenerator codegen(symbols);
+            codegen.setRegisterFile(registers);
+            codegen.generate(statements);
+            Outcome vm = execute(codegen, symbols);
+            codegen.setJit(true);
+            if (!(execute(codegen, symbols) == vm)) mismatches++;
+        }
+    }
+    expect(mismatches == 0, "el JIT coincide con la VM en programas aleatorios");
+}
+
+// Runs `source` with the optimizer passes in the low five bits of `passes`
+// (folding, algebraic, CSE, copies, dead stores), or unoptimized at 32.
+Outcome optimized(const std::string& source, uint32_t passes, bool share) {
+    Interner symbols;
+    Lexer lexer(source, symbols);
+    Parser parser(source, lexer.scan(), symbols);
+    parser.shareExpressions(share);
+    Ast statements = parser.parse();
+    SemanticAnalyzer semantic(symbols);
+    semantic.analyze(statements);
+    CodeGenerator codegen(symbols);
+    OptimizerOptions& options = codegen.optimizerOptions();
+    options.enabled = passes < 32;
+    options.constantFolding = passes & 1;
+    options.algebraic = passes & 2;
+    options.cse = passes & 4;
+    options.copyPropagation = passes & 8;
+    options.deadStores = passes & 16;
+    codegen.generate(statements);
+    return execute(codegen, symbols);
+}
+
+// Optimized code must print, leave and fail exactly as unoptimized code
+// does, bit for bit, under every subset of the passes: with folding off the
+// others see operands that are not constants. `(0 - 0.5) * 0` gives -0, for
+// which `x + 0` is not `x`; a division that may fail must be kept even when
+// its result is dead, and the variables it would leave behind with it; and
+// a reassigned variable must drop the CSE and copy entries that read it.
+void checkOptimizer() {
+    std::string huge = "1" + std::string(308, '0');
+    std::vector<std::string> sources = {
+        "a = 0 - 0.5; b = a * 0; c = b + 0; print(c); d = 0 + b; print(d); print(b - 0);",
+        "a = 2; b = 1 / 0; a = 3;",
+        "a = 3; b = a * 2; a = 5; c = a * 2; print(b); print(c);",
+        "a = 3; b = a; a = 4; print(b); a = b; print(a);",
+    };
+    for (uint32_t seed = 1; seed <= 300; seed++) sources.push_back(RandomProgram(seed, {"0", "1", huge}).generate(40));
+    int mismatches = 0;
+    for (size_t i = 0; i < sources.size(); i++) {
+        Outcome plain = optimized(sources[i], 32, false);
+        for (uint32_t passes = 0; passes < 32; passes++) {
+            if (!(optimized(sources[i], passes, i % 2 == 0) == plain)) mismatches++;
+        }
+    }
+    expect(mismatches == 0, "el optimizador no cambia lo que el programa imprime, deja o falla");
+    
+    // Literals near DBL_MAX overflow to inf, which stays a run-time result
+    // rather than a literal no listing could spell.
+    Interner symbols;
+    std::string source = "a = " + huge + " * 10; b = a - a; print(b);";
+    Lexer lexer(source, symbols);
+    Parser parser(source, lexer.scan(), symbols);
+    Ast statements = parser.parse();
+    SemanticAnalyzer semantic(symbols);
+    semantic.analyze(statements);
+    CodeGenerator codegen(symbols);
+    std::string listing = codegen.generate(statements);
+    expect(listing.find("inf") == std::string::npos && listing.find("nan") == std::string::npos,
+           "el plegado de constantes no produce valores no finitos");
+}
+
+// The optimizer folds every literal a temp would hold into its readers, so
+// LOAD into a machine register only comes from hand-built bytecode: one
+// literal into each of xmm3-xmm15, all printed afterwards.
+void checkJitLoad() {
+    if (!JitFunction::supported()) return;
+    Program program;
+    for (uint32_t k = 0; k < JitFunction::MACHINE_REGISTERS; k++) {
+        program.registerNames.push_back("%r" + std::to_string(k));
+        program.machineSlots.push_back(registerSlot(k));
+        program.code.push_back(loadImmediate(registerSlot(k), k * 1.25 - 3));
+    }
+    for (uint32_t k = 0; k < JitFunction::MACHINE_REGISTERS; k++) {
+        program.code.push_back({OpCode::PRINT, 0, registerSlot(k), 0});
+    }
+    std::vector<double> expected, printed;
+    VM vm;
+    vm.setPrinter(recordClobbering, &expected);
+    vm.run(program);
+    JitFunction native;
+    native.compile(program);
+    vm.reset();
+    native.run(vm.prepare(program), recordClobbering, &printed);
+    expect(printed == expected && expected.size() == JitFunction::MACHINE_REGISTERS, "LOAD del JIT en xmm3-xmm15");
+}
+
+// A sink that throws must surface as an exception from run() on both the
+// VM and the JIT path, without running the sink again and ahead of the
+// division by zero that follows it.
+void checkThrowingSink() {
+    for (bool jit : {false, true}) {
+        if (jit && !JitFunction::supported()) continue;
+        CompileOptions options;
+        options.jit = jit;
+        CompiledProgram program = compile("print(a); print(a + 1); print(a + 2); z = a - a; w = 1 / z;", {"a"}, options);
+        int calls = 0;
+        std::string error;
+        try {
+            run(program, {{"a", 1}}, [&](double) {
+                if (++calls == 2) throw std::runtime_error("sumidero");
+            });
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        expect(error == "sumidero" && calls == 2, jit ? "excepcion del sumidero con JIT" : "excepcion del sumidero en la VM");
+    }
+}
+
+// A program compiled with the C++ code must agree with compile() and run();
+// one the analyzer rejects must be rejected by compileStatic as well, which
+// outside a constant expression throws instead of stopping the build.
+void checkStatic() {
+    const char* source = "neto = precio * cantidad; total = neto * 1.21 - 0.5; print(total / 2);";
+    double variables[StaticTotal::VARIABLES] = {2.5, 4};
+    double printed = 0;
+    StaticTotal::run(variables, [](void* context, double value) { *static_cast<double*>(context) = value; }, &printed);
+    double expected = 0;
+    RunResult result = run(compile(source, {"precio", "cantidad"}), {{"precio", 2.5}, {"cantidad", 4}},
+                           [&](double value) { expected = value; });
+    expect(variables[StaticTotal::variable("total")] == result.get("total") && printed == expected,
+           "MINICOMPILER_STATIC coincide con compile()");
+    
+    double input[StaticEmpty::VARIABLES] = {7};
+    StaticEmpty::run(input);
+    expect(input[0] == 7, "programa estatico vacio");
+    
+    std::string error;
+    try {
+        compileStatic<64>("a", "b = a + c;");
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    expect(error == "Error semantico: variable no definida", "compileStatic rechaza una variable no definida");
+    
+    // At the edges of the exact range literals read as the runtime reads
+    // them; past them, where a single scaling could round differently, they
+    // are refused.
+    for (const char* literal : {"9007199254740992", "0.1234567890123456", "0.0000000000000000000001",
+                                "1.50000000000000000000000000", "9007199254740992000000000000000000000"}) {
+        expect(parseStaticNumber(literal) == parseNumber(literal), "literal estatico exacto igual al de la VM");
+    }
+    std::string tooLong = "1" + std::string(400, '0');
+    for (const char* literal : {"9007199254740993", "0.30000000000000004", "0.00000000000000000000001", tooLong.c_str()}) {
+        bool refused = false;
+        try {
+            parseStaticNumber(literal);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        expect(refused, "literal estatico sin lectura exacta rechazado");
+    }
+}
+
+// Nesting lives on the parser's operator stack, not the call stack, and
+// every later pass walks the flat Ast: 200k nested parentheses on either
+// side would overflow a recursive parser's stack, and a million-term sum
+// would stall one that rescans its input.
+void checkDeepExpressions() {
+    const size_t depth = 200000, terms = 1000000;
+    std::string left = "x = " + std::string(depth, '(') + "a";
+    for (size_t i = 0; i < depth; i++) left += " + 1)";
+    std::string right = "x = ";
+    for (size_t i = 0; i < depth; i++) right += "1 + (";
+    right += "a" + std::string(depth, ')');
+    std::string sum = "x = a";
+    for (size_t i = 1; i < terms; i++) sum += " + a";
+    for (const std::string* source : {&left, &right, &sum}) {
+        double printed = 0;
+        RunResult result = run(compile(*source + "; print(x);", {"a"}), {{"a", 0.5}}, [&](double value) { printed = value; });
+        double expected = source == &sum ? terms * 0.5 : depth + 0.5;
+        expect(printed == expected && result.get("x") == expected, "expresiones profundas y largas sin recursion");
+    }
+}
+
+// A line that fails at run time is undone as a whole: an existing variable
+// gets its old value back and a new one is undefined again, even when its
+// assignment ran before the failing division.
+void checkReplRollback() {
+    std::ostringstream out, err;
+    REPL repl(out, err);
+    for (const char* line : {"x = 1;", "x = 5; y = 2; z = x / 0;", "print(x);", "print(y);"}) repl.evaluateLine(line);
+    expect(out.str() == "1\n", "una linea que falla no deja valores asignados");
+    expect(err.str().find("'y' no definida") != std::string::npos, "una linea que falla no deja variables nuevas");
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// A fresh directory for the files a check writes.
+std::string scratchDirectory() {
+    char path[] = "/tmp/minicompiler-check-XXXXXX";
+    if (!mkdtemp(path)) throw std::runtime_error("no se pudo crear un directorio temporal");
+    return path;
+}
+
+struct Session {
+    std::ostringstream out, err;
+    REPL repl{out, err};
+    
+    void feed(std::initializer_list<const char*> lines) {
+        for (const char* line : lines) repl.evaluateLine(line);
+    }
+    
+    // What :vars and printing each of `names` show, diagnostics included.
+    std::string state(std::initializer_list<const char*> names) {
+        out.str("");
+        err.str("");
+        repl.evaluateLine(":vars");
+        for (const char* name : names) repl.evaluateLine("print(" + std::string(name) + ");");
+        return out.str() + err.str();
+    }
+};
+
+// :save and :load must keep a session as if it had run every line itself,
+// also when a session restored from a file saves over that same file while
+// it is still mapped, and after :clear. A truncated or damaged file must be
+// refused without touching the session that tried to load it.
+void checkSnapshot() {
+    std::string directory = scratchDirectory();
+    std::string first = directory + "/a.mcs", second = directory + "/b.mcs", damaged = directory + "/c.mcs";
+    auto names = {"x", "y", "z", "w"};
+    
+    Session direct;
+    direct.feed({"x = 2;", "y = x * 3;", "z = x + y;", "w = z * 2;"});
+    Session saved;
+    saved.feed({"x = 2;", "y = x * 3;", (":save " + first).c_str()});
+    Session restored;
+    restored.feed({(":load " + first).c_str(), "z = x + y;", (":save " + first).c_str(), (":load " + first).c_str(),
+                   "w = z * 2;", (":save " + second).c_str()});
+    expect(restored.err.str().empty(), "guardar sobre la sesion mapeada");
+    Session reloaded;
+    reloaded.feed({(":load " + second).c_str()});
+    std::string expected = direct.state(names);
+    expect(restored.state(names) == expected && reloaded.state(names) == expected, "guardar y restaurar dos veces");
+    
+    Session cleared;
+    cleared.feed({"a = 1;", ":clear", (":load " + second).c_str()});
+    expect(cleared.state(names) == expected && cleared.state({"a"}) == direct.state({"a"}), ":clear y luego :load");
+    cleared.feed({"k = w + x;", (":save " + first).c_str()});
+    Session again;
+    again.feed({(":load " + first).c_str()});
+    direct.feed({"k = w + x;"});
+    expect(again.state({"k"}) == direct.state({"k"}), ":load de una sesion guardada tras :clear");
+    
+    // offsets[] begins 40 bytes into the header; their low byte is a
+    // multiple of 16, so flipping it always misaligns the section.
+    std::string image = readFile(second);
+    std::vector<size_t> mustRefuse = {0, 7, 8, 11};
+    for (size_t offset = 40; offset < 40 + 11 * 8; offset += 8) mustRefuse.push_back(offset);
+    bool refused = true, untouched = true;
+    auto tryLoad = [&](const std::string& bytes, bool required) {
+        writeFile(damaged, bytes);
+        Session session;
+        session.feed({"q = 7;"});
+        std::string before = session.state({"q", "x"});
+        session.err.str("");
+        session.feed({(":load " + damaged).c_str()});
+        bool failed = session.err.str().find("no es una sesion valida") != std::string::npos;
+        if (required && !failed) refused = false;
+        if (failed && session.state({"q", "x"}) != before) untouched = false;
+    };
+    for (size_t size : {size_t(0), size_t(8), size_t(100), image.size() / 2, image.size() - 1}) tryLoad(image.substr(0, size), true);
+    for (size_t i = 0; i < image.size(); i++) {
+        std::string flipped = image;
+        flipped[i] = static_cast<char>(flipped[i] ^ 0xff);
+        tryLoad(flipped, std::find(mustRefuse.begin(), mustRefuse.end(), i) != mustRefuse.end());
+    }
+    expect(refused, "una sesion truncada o con la cabecera danada se rechaza");
+    expect(untouched, "una sesion rechazada no cambia la sesion actual");
+    
+    for (const std::string& path : {first, second, damaged}) std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+// A snapshot with section `index` replaced by `bytes`, holding `count`
+// entries. As in Snapshot::Header, offsets[] starts 40 bytes in and counts[]
+// 88 bytes after it; the new section goes at the end of the file.
+std::string replaceSection(std::string image, size_t index, const std::string& bytes, uint64_t count) {
+    image.resize((image.size() + 15) / 16 * 16, '\0');
+    uint64_t offset = image.size();
+    std::memcpy(&image[40 + 8 * index], &offset, sizeof(offset));
+    std::memcpy(&image[128 + 8 * index], &count, sizeof(count));
+    return image + bytes;
+}
+
+// Register names are parsed back into slot indices on load, so one that is
+// not %t, %s, %c or %r followed by an index below the register count must
+// be refused rather than indexed by.
+void checkSnapshotRegisters() {
+    const size_t REGISTER_OFFSETS = 8, REGISTER_TEXT = 9;
+    std::string directory = scratchDirectory();
+    std::string saved = directory + "/a.mcs", crafted = directory + "/b.mcs";
+    Session session;
+    session.feed({"x = 2;", "y = (x + 1) * (x + 3);", (":save " + saved).c_str()});
+    std::string image = readFile(saved);
+    uint64_t registers = 0;
+    std::memcpy(&registers, &image[128 + 8 * REGISTER_OFFSETS], sizeof(registers));
+    registers--;
+    
+    bool refused = true;
+    for (const char* bad : {"%t4294967295", "%t100000000", "%t", "%x0", "%t1a", "%c-1", "t00"}) {
+        std::vector<uint32_t> offsets{0};
+        std::string text;
+        for (uint64_t i = 0; i < registers; i++) {
+            text += i == 0 ? std::string(bad) : "%t" + std::to_string(i);
+            offsets.push_back(static_cast<uint32_t>(text.size()));
+        }
+        std::string table(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        std::string damaged = replaceSection(image, REGISTER_OFFSETS, table, offsets.size());
+        damaged = replaceSection(damaged, REGISTER_TEXT, text, text.size());
+        writeFile(crafted, damaged);
+        Session loading;
+        loading.feed({(":load " + crafted).c_str()});
+        if (loading.err.str().find("no es una sesion valida") == std::string::npos) refused = false;
+    }
+    expect(registers > 0 && refused, "una sesion con un nombre de registro mal formado se rechaza");
+    
+    for (const std::string& path : {saved, crafted}) std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+// The interner's hash table is rebuilt from the names on load: a saved table
+// with no empty slot, or hashes that do not match the names, must not hang
+// or split the next lookups, and two ids with the same name are refused.
+void checkSnapshotNames() {
+    const size_t HASH_TABLE = 0, HASHES = 1, NAME_TEXT = 3;
+    std::string directory = scratchDirectory();
+    std::string saved = directory + "/a.mcs", crafted = directory + "/b.mcs";
+    Session session;
+    session.feed({"x = 2;", "y = x * 3;", (":save " + saved).c_str()});
+    std::string image = readFile(saved);
+    uint64_t tableSize = 0, names = 0;
+    std::memcpy(&tableSize, &image[128 + 8 * HASH_TABLE], sizeof(tableSize));
+    std::memcpy(&names, &image[128 + 8 * HASHES], sizeof(names));
+    
+    auto load = [&](const std::string& bytes, std::initializer_list<const char*> lines) {
+        writeFile(crafted, bytes);
+        Session loading;
+        loading.feed({(":load " + crafted).c_str()});
+        loading.feed(lines);
+        return loading.out.str() + loading.err.str();
+    };
+    std::string expected = load(image, {"nuevo = x + y;", "print(nuevo);", "print(y);"});
+    std::string full = replaceSection(image, HASH_TABLE, std::string(tableSize * sizeof(uint32_t), '\0'), tableSize);
+    std::string unhashed = replaceSection(image, HASHES, std::string(names * sizeof(uint64_t), '\0'), names);
+    expect(expected.find("8\n6") != std::string::npos && load(full, {"nuevo = x + y;", "print(nuevo);", "print(y);"}) == expected &&
+           load(unhashed, {"nuevo = x + y;", "print(nuevo);", "print(y);"}) == expected,
+           "la tabla de simbolos de una sesion se reconstruye al cargarla");
+    expect(load(replaceSection(image, NAME_TEXT, "xx", 2), {}).find("no es una sesion valida") != std::string::npos,
+           "una sesion con nombres repetidos se rechaza");
+    
+    for (const std::string& path : {saved, crafted}) std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+// A blocking client of Server that gives up after two seconds without data.
+class Client {
+private:
+    int fd;
+    
+public:
+    explicit Client(const std::string& path) : fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        timeval timeout{2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            throw std::runtime_error("no se pudo conectar al servidor");
+        }
+    }
+    
+    ~Client() {
+        if (fd >= 0) ::close(fd);
+    }
+    
+    void send(const std::string& text) {
+        ::send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+    }
+    
+    // Everything up to the `prompts`-th ">>> ", which ends every reply.
+    std::string receive(int prompts) {
+        std::string text;
+        char chunk[4096];
+        size_t seen = 0, from = 0;
+        while (seen < static_cast<size_t>(prompts)) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) break;
+            text.append(chunk, static_cast<size_t>(n));
+            for (size_t at; (at = text.find(">>> ", from)) != std::string::npos; from = at + 4) seen++;
+        }
+        return text;
+    }
+    
+    void disconnect() {
+        ::close(fd);
+        fd = -1;
+    }
+};
+
+// Two clients of one server get sessions of their own, and a client that
+// disconnects halfway through a line only ends its own session.
+void checkServer() {
+    std::string directory = scratchDirectory();
+    std::string path = directory + "/s.sock";
+    Server server(path);
+    server.start(2);
+    {
+        Client first(path), second(path);
+        first.receive(1);
+        second.receive(1);
+        first.send("x = 1;\nprint(x + 1);\n");
+        expect(first.receive(2) == ">>> 2\n>>> ", "el servidor evalua las lineas de un cliente");
+        second.send("print(x);\n");
+        expect(second.receive(1).find("'x' no definida") != std::string::npos, "cada cliente tiene su propia sesion");
+        
+        Client leaving(path);
+        leaving.receive(1);
+        leaving.send("y = (1 +");
+        leaving.disconnect();
+        first.send("x = x * 5;\nprint(x);\n");
+        expect(first.receive(2) == ">>> 5\n>>> ", "una desconexion a media linea no afecta a otras sesiones");
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (server.sessionCount() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    expect(server.sessionCount() == 0, "el servidor cierra las sesiones de los clientes desconectados");
+    Client later(path);
+    later.receive(1);
+    later.send("print(3);\n");
+    expect(later.receive(1) == "3\n>>> ", "el servidor sigue atendiendo tras las desconexiones");
+    server.stop();
+    rmdir(directory.c_str());
+}
+
+// What `f` writes to descriptor 1, where PrintBuffer sends printed values.
+template <typename F>
+std::string captureStdout(const std::string& path, F f) {
+    std::fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    ::close(fd);
+    f();
+    std::cout.flush();
+    std::fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    ::close(saved);
+    return readFile(path);
+}
+
+// A cached image that is stale, was built from other source, is truncated
+// or names a slot outside its frame must be ignored: the run compiles the
+// script again, prints what an uncached run prints and rewrites the image.
+void checkCache() {
+    std::string directory = scratchDirectory();
+    std::string script = directory + "/s.mc", output = directory + "/out", images = directory + "/cache";
+    std::string source = "a = 3;\nb = a * 2 + 1;\nprint(b / 4);\nc = b - a;\nprint(c);\nprint(c * b);\n";
+    writeFile(script, source);
+    auto runScript = [&](bool cached, uint64_t* parsed = nullptr) {
+        return captureStdout(output, [&] {
+            BatchDriver driver;
+            if (cached) driver.setCache(images);
+            driver.processFile(script, BatchMode::RUN);
+            driver.flushOutput();
+            if (parsed) *parsed = driver.getStats().get(Phase::PARSER).calls;
+        });
+    };
+    std::string expected = runScript(false);
+    uint64_t parsed = 0;
+    expect(runScript(true) == expected && runScript(true, &parsed) == expected && parsed == 0, "la cache reproduce la salida");
+    
+    BytecodeCache cache(images);
+    uint64_t hash = BytecodeCache::key(source);
+    std::string image = readFile(cache.path(hash)), damaged;
+    CacheHeader header;
+    std::memcpy(&header, image.data(), sizeof(header));
+    auto patch = [&](size_t offset, const void* value, size_t size) {
+        damaged = image;
+        damaged.replace(offset, size, static_cast<const char*>(value), size);
+        return damaged;
+    };
+    uint32_t stale = BytecodeCache::VERSION - 1;
+    uint64_t otherHash = hash ^ 1;
+    Slot outside = static_cast<Slot>(header.variableCount);
+    std::vector<std::pair<const char*, std::string>> cases = {
+        {"imagen de otra VERSION", patch(offsetof(CacheHeader, version), &stale, sizeof(stale))},
+        {"imagen de otra fuente", patch(offsetof(CacheHeader, sourceHash), &otherHash, sizeof(otherHash))},
+        {"imagen truncada", image.substr(0, image.size() - 1)},
+        {"imagen sin bytecode", image.substr(0, header.codeOffset + sizeof(Bytecode))},
+        {"imagen con un slot fuera de rango", patch(header.codeOffset + offsetof(Bytecode, dst), &outside, sizeof(outside))},
+    };
+    for (const auto& [what, bytes] : cases) {
+        writeFile(cache.path(hash), bytes);
+        bool refused = !cache.load(hash, source.size());
+        expect(refused && runScript(true, &parsed) == expected && parsed > 0 && cache.load(hash, source.size()), what);
+    }
+    
+    for (const std::string& path : {script, output, cache.path(hash)}) std::remove(path.c_str());
+    rmdir(images.c_str());
+    rmdir(directory.c_str());
+}
+
+// Some statements of a random script replaced by lexical, syntax and
+// semantic errors; a long one spans more than one 1024-statement chunk.
+std::string brokenScript(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string script = RandomProgram(seed).generate(seed % 10 == 0 ? 1500 : 40);
+    std::vector<std::string> lines;
+    for (size_t start = 0, end; (end = script.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(script.substr(start, end - start + 1));
+    }
+    const char* errors[] = {"v0 = nada + 1;\n", "print(otra * 2);\n", "v1 = (2 + ;\n", "v2 = 1.2.3;\n",
+                            "print(v0 $ 1);\n", "v3 = 4 print(1);\n"};
+    for (uint32_t k = rng() % 4; k > 0; k--) lines[rng() % lines.size()] = errors[rng() % 6];
+    std::string broken;
+    for (const std::string& line : lines) broken += line;
+    return broken;
+}
+
+// BatchDriver's output and diagnostic for `source`, with or without --fused.
+std::string batchOutput(const std::string& source, BatchMode mode, bool fused, const std::string& capture) {
+    std::string error;
+    std::string output = captureStdout(capture, [&] {
+        BatchDriver driver;
+        driver.setFused(fused);
+        try {
+            driver.process(source, mode);
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        driver.flushOutput();
+    });
+    return output + "\n--\n" + error;
+}
+
+// --fused must list, print and fail exactly as the Ast pipeline does; a
+// semantic error is held until its chunk has parsed, so a later syntax
+// error in the same chunk is the one reported.
+void checkFused() {
+    std::string directory = scratchDirectory();
+    std::string capture = directory + "/out";
+    std::vector<std::string> sources = {"a = 1; b = c + 1; d = (2;", "a = 1; b = c + 1; print(a);", "x = 2; y = 1.2.3; z = w;"};
+    for (uint32_t seed = 1; seed <= 300; seed++) sources.push_back(brokenScript(seed));
+    int mismatches = 0;
+    for (const std::string& source : sources) {
+        for (BatchMode mode : {BatchMode::COMPILE, BatchMode::RUN}) {
+            if (batchOutput(source, mode, true, capture) != batchOutput(source, mode, false, capture)) mismatches++;
+        }
+    }
+    expect(mismatches == 0, "--fused coincide con el Ast en listados, salida y errores");
+    expect(batchOutput(sources[0], BatchMode::COMPILE, true, capture).find("Error sintaxis") != std::string::npos,
+           "--fused informa del error sintactico tras uno semantico");
+    std::remove(capture.c_str());
+    rmdir(directory.c_str());
+}
+
+// At the end of a whole program nothing reads the variables, so a store no
+// print reads is dropped from the listing; one a later chunk reads is not.
+// A literal overflowing to inf keeps the values from being folded away.
+void checkDeadVariables() {
+    std::string directory = scratchDirectory();
+    std::string capture = directory + "/out";
+    std::string huge = "1" + std::string(308, '0');
+    std::string source = "x = " + huge + " * 10;\ny = x - 1;\nprint(x);\n";
+    std::string listing = batchOutput(source, BatchMode::COMPILE, false, capture);
+    expect(listing.find("y =") == std::string::npos && listing.find("x =") == std::string::npos &&
+           listing.find("print") != std::string::npos, "la ultima parte del programa elimina variables muertas");
+    expect(batchOutput(source, BatchMode::COMPILE, true, capture) == listing, "--fused elimina las mismas variables");
+    
+    std::string chunks = "x = " + huge + " * 10;\n";
+    for (int i = 0; i < 1100; i++) chunks += "print(1);\n";
+    chunks += "print(x - 1);\n";
+    expect(batchOutput(chunks, BatchMode::RUN, false, capture).find("inf\n\n--\n") != std::string::npos,
+           "una variable leida en la parte siguiente se conserva");
+    
+    CompileOptions options;
+    const char* program = "neto = precio * cantidad; doble = neto * 2; print(neto);";
+    size_t kept = compile(program, {"precio", "cantidad"}).instructionCount();
+    options.keepVariables = false;
+    CompiledProgram pruned = compile(program, {"precio", "cantidad"}, options);
+    double printed = 0;
+    run(pruned, {{"precio", 2.5}, {"cantidad", 4}}, [&](double value) { printed = value; });
+    expect(pruned.instructionCount() < kept && printed == 10, "keepVariables = false elimina variables muertas");
+    std::remove(capture.c_str());
+    rmdir(directory.c_str());
+}
+
+// About 1.5 MB of rows makes at least four times as many shards as threads
+// (64 KB at least each), so workers wait on the look-ahead window. A
+// division by zero a sixth of the way in fails while later shards are still
+// waiting there: the run must name the line, publish no output and release
+// those workers rather than hang. A correct file must give the same bytes on
+// one thread as on several.
+void checkCsv() {
+    std::string directory = scratchDirectory();
+    std::string good = directory + "/bien.csv", bad = directory + "/mal.csv";
+    std::string one = directory + "/uno.csv", many = directory + "/varios.csv", failed = directory + "/fallo.csv";
+    const size_t rows = 120000, zero = 20000;
+    std::string text = "a,b\n", broken = text;
+    for (size_t i = 0; i < rows; i++) {
+        std::string row = std::to_string(i) + "," + std::to_string(1 + i % 7) + ".25\n";
+        text += row;
+        broken += i == zero ? std::to_string(i) + ",0\n" : row;
+    }
+    writeFile(good, text);
+    writeFile(bad, broken);
+    const char* script = "y = a / b; print(y); print(a * 2 - y);";
+    
+    size_t done = CsvEvaluator(1, false).runToFile(script, good, one);
+    expect(done == rows && CsvEvaluator(4, false).runToFile(script, good, many) == rows && readFile(one) == readFile(many),
+           "CSV con uno y varios hilos da la misma salida");
+    for (unsigned threads : {1u, 4u}) {
+        std::string error;
+        try {
+            CsvEvaluator(threads, false).runToFile(script, bad, failed);
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        expect(error == "Division por cero (linea " + std::to_string(zero + 2) + ")", "CSV informa de la linea que falla");
+        expect(::access(failed.c_str(), F_OK) != 0, "CSV no publica la salida de una ejecucion fallida");
+    }
+    
+    for (const std::string& path : {good, bad, one, many}) std::remove(path.c_str());
+    rmdir(directory.c_str());
+}
+
+}
+
+int main() {
+    checkBatch();
+    checkJit();
+    checkOptimizer();
+    checkJitLoad();
+    checkDeepExpressions();
+    checkThrowingSink();
+    checkStatic();
+    checkReplRollback();
+    checkSnapshot();
+    checkSnapshotRegisters();
+    checkSnapshotNames();
+    checkCache();
+    checkFused();
+    checkDeadVariables();
+    checkCsv();
+    checkServer();
+    if (failures == 0) std::printf("ok\n");
+    return failures == 0 ? 0 : 1;
+}
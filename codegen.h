@@ -2,103 +2,320 @@
 #define CODEGEN_H
 
 #include "parser.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "regalloc.h"
+#include "vm.h"
+#include "jit.h"
+#include "profile.h"
+#include <charconv>
+#include <iterator>
 #include <sstream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
-struct Instruction {
-    std::string op, arg1, arg2, result;
-    
-    std::string toString() const {
-        if (op == "=") return result + " = " + arg1;
-        if (op == "print") return "print " + arg1;
-        return result + " = " + arg1 + " " + op + " " + arg2;
-    }
-};
-
 class CodeGenerator {
 private:
     std::vector<Instruction> instructions;
-    int tempCounter;
-    std::map<std::string, double> memory;
+    uint32_t tempCounter;
+    Program program;
+    const Interner* symbols;
+    // Slots of %tK and %sK by K; those of %rK are the program's
+    // machineSlots. Register slots are negative, so 0 marks a temp without
+    // one.
+    std::vector<Slot> tempSlots;
+    std::vector<Slot> spillSlots;
+    // Literals read by the chunk being lowered, by their bits, each in one
+    // of the %cK slots shared by every chunk.
+    std::vector<Slot> constantPool;
+    std::unordered_map<uint64_t, Slot> constantSlots;
+    size_t executed;
+    size_t flushed;
+    const Ast* ast;
+    NodeId first;
+    std::vector<Operand> operands;
+    std::unordered_map<NodeId, Operand> sharedOperands;
+    Optimizer optimizer;
+    RegisterAllocator allocator;
+    bool jitEnabled;
+    bool listing;
+    JitFunction jitted;
+    size_t jittedSize;
+    
+    Operand newTemp() {
+        return Operand::temp(tempCounter++);
+    }
+    
+    // A shared node keeps its operand for the rest of the chunk, so later
+    // statements reuse the temp it was computed into.
+    Operand& operandOf(NodeId id) {
+        return id >= first ? operands[id - first] : sharedOperands.at(id);
+    }
+    
+    void keep(NodeId id, const ASTNode& node) {
+        if (node.shared) sharedOperands[id] = operands.back();
+    }
+    
+    template <typename Visitor>
+    friend void walk(const Ast&, Visitor&);
+    template <typename Visitor>
+    friend void walkExpression(const Ast&, NodeId, NodeId, Visitor&);
+    friend class Snapshot;
     
-    std::string newTemp() {
-        return "t" + std::to_string(tempCounter++);
+    void beginStatement(NodeId firstNode) {
+        first = firstNode;
+        operands.clear();
+    }
+    
+    void number(NodeId id, const ASTNode& node) {
+        operands.push_back(Operand::number(node.value));
+        keep(id, node);
+    }
+    
+    void identifier(NodeId id, const ASTNode& node) {
+        operands.push_back(Operand::variable(node.symbol));
+        keep(id, node);
+    }
+    
+    void binaryOp(NodeId id, const ASTNode& node) {
+        Operand temp = newTemp();
+        instructions.push_back({std::string(1, node.op), operandOf(node.left), operandOf(node.right), temp, node.location});
+        operands.push_back(temp);
+        keep(id, node);
+    }
+    
+    void assignment(NodeId, const ASTNode& node) {
+        instructions.push_back({"=", operandOf(node.left), {}, Operand::variable(node.symbol), node.location});
+    }
+    
+    void print(NodeId, const ASTNode& node) {
+        instructions.push_back({"print", operandOf(node.left), {}, {}, node.location});
+    }
+    
+    std::vector<Slot>& slotsOf(OperandKind kind) {
+        if (kind == OperandKind::TEMP) return tempSlots;
+        if (kind == OperandKind::SPILL) return spillSlots;
+        return program.machineSlots;
+    }
+    
+    Slot slot(const Operand& value) {
+        if (value.kind == OperandKind::VARIABLE) {
+            program.variableCount = std::max(program.variableCount, value.index + 1);
+            return static_cast<Slot>(value.index);
+        }
+        std::vector<Slot>& slots = slotsOf(value.kind);
+        if (value.index >= slots.size()) slots.resize(value.index + 1, 0);
+        if (slots[value.index] == 0) {
+            slots[value.index] = registerSlot(program.registerCount());
+            program.registerNames.push_back(value.toString(*symbols));
+        }
+        return slots[value.index];
+    }
+    
+    void emit(const Bytecode& code, const SourceLocation& location) {
+        program.code.push_back(code);
+        program.locations.push_back(location);
+    }
+    
+    // A literal is loaded into a %cK slot the first time its chunk reads it,
+    // so the slots a script needs grow with the literals of one chunk, not
+    // with those of the whole script.
+    Slot read(const Operand& value, const SourceLocation& location) {
+        if (!isConstant(value)) return slot(value);
+        auto it = constantSlots.find(value.key());
+        if (it != constantSlots.end()) return it->second;
+        size_t k = constantSlots.size();
+        if (k == constantPool.size()) {
+            constantPool.push_back(registerSlot(program.registerCount()));
+            program.registerNames.push_back("%c" + std::to_string(k));
+        }
+        emit(loadImmediate(constantPool[k], value.value), location);
+        constantSlots.emplace(value.key(), constantPool[k]);
+        return constantPool[k];
+    }
+    
+    // A snapshot keeps the register names but not these maps; every name
+    // is %tK, %rK, %sK or %cK, and %rK are already in machineSlots.
+    void indexSlots() {
+        tempSlots.clear();
+        spillSlots.clear();
+        constantPool.clear();
+        constantSlots.clear();
+        for (uint32_t i = 0; i < program.registerCount(); i++) {
+            const std::string& name = program.registerNames[i];
+            if (name.size() < 3 || name[0] != '%' || name[1] == 'r') continue;
+            size_t k = 0;
+            std::from_chars(name.data() + 2, name.data() + name.size(), k);
+            std::vector<Slot>& slots = name[1] == 't' ? tempSlots : name[1] == 's' ? spillSlots : constantPool;
+            if (k >= slots.size()) slots.resize(k + 1, 0);
+            slots[k] = registerSlot(i);
+        }
     }
     
-    std::string generateExpression(const ASTNode* node) {
-        if (auto* numNode = dynamic_cast<const NumberNode*>(node)) {
-            return std::to_string(numNode->value);
+    void lower(const Instruction& inst) {
+        if (inst.op == "=" && isConstant(inst.arg1)) {
+            emit(loadImmediate(slot(inst.result), inst.arg1.value), inst.location);
         }
-        if (auto* idNode = dynamic_cast<const IdentifierNode*>(node)) {
-            return idNode->name;
+        else if (inst.op == "=") {
+            emit({OpCode::MOVE, slot(inst.result), slot(inst.arg1), 0}, inst.location);
         }
-        if (auto* binOp = dynamic_cast<const BinaryOpNode*>(node)) {
-            std::string left = generateExpression(binOp->left.get());
-            std::string right = generateExpression(binOp->right.get());
-            std::string temp = newTemp();
-            instructions.push_back({binOp->op, left, right, temp});
-            return temp;
+        else if (inst.op == "print") {
+            Slot a = read(inst.arg1, inst.location);
+            emit({OpCode::PRINT, 0, a, 0}, inst.location);
+        }
+        else {
+            OpCode code = OpCode::ADD;
+            if (inst.op == "-") code = OpCode::SUB;
+            else if (inst.op == "*") code = OpCode::MUL;
+            else if (inst.op == "/") code = OpCode::DIV;
+            Slot a = read(inst.arg1, inst.location);
+            Slot b = read(inst.arg2, inst.location);
+            emit({code, slot(inst.result), a, b}, inst.location);
         }
-        return "";
     }
     
-    void generateStatement(const ASTNode* node) {
-        if (auto* assignNode = dynamic_cast<const AssignmentNode*>(node)) {
-            std::string exprResult = generateExpression(assignNode->expression.get());
-            instructions.push_back({"=", exprResult, "", assignNode->variable});
+    // Optimizes, allocates and lowers the IR from `start` on, returning
+    // its listing unless listings are off.
+    std::string finish(size_t start) {
+        if (optimizer.enabled()) {
+            std::vector<Instruction> chunk(instructions.begin() + start, instructions.end());
+            optimizer.run(chunk, *symbols);
+            instructions.resize(start);
+            instructions.insert(instructions.end(), chunk.begin(), chunk.end());
+        }
+        allocator.run(instructions, start);
+        constantSlots.clear();
+        if (!listing) {
+            for (size_t i = start; i < instructions.size(); i++) lower(instructions[i]);
+            return {};
         }
-        else if (auto* printNode = dynamic_cast<const PrintNode*>(node)) {
-            std::string exprResult = generateExpression(printNode->expression.get());
-            instructions.push_back({"print", exprResult, "", ""});
+        std::stringstream ss;
+        for (size_t i = start; i < instructions.size(); i++) {
+            lower(instructions[i]);
+            ss << flushed + i + 1 << ": " << instructions[i].toString(*symbols) << "\n";
         }
+        return ss.str();
     }
     
 public:
-    CodeGenerator() : tempCounter(0) {}
+    explicit CodeGenerator(const Interner& interner)
+        : tempCounter(0), symbols(&interner), executed(0), flushed(0), ast(nullptr), first(0),
+          jitEnabled(false), listing(true), jittedSize(0) {}
     
-    std::string generate(const std::vector<std::unique_ptr<ASTNode>>& statements) {
+    std::string generate(const Ast& statements) {
         instructions.clear();
+        program.clear();
+        tempSlots.clear();
+        spillSlots.clear();
+        constantPool.clear();
+        constantSlots.clear();
+        jitted = JitFunction();
+        executed = 0;
+        flushed = 0;
+        return append(statements);
+    }
+    
+    std::string append(const Ast& statements) {
+        size_t start = instructions.size();
         tempCounter = 0;
-        for (const auto& stmt : statements) {
-            generateStatement(stmt.get());
+        ast = &statements;
+        sharedOperands.clear();
+        walk(statements, *this);
+        return finish(start);
+    }
+    
+    // IR emitted straight from the token stream by Translator, with temps
+    // numbered from %t0 for each chunk as walking an Ast would.
+    std::string append(std::vector<Instruction>&& code) {
+        size_t start = instructions.size();
+        instructions.insert(instructions.end(), std::make_move_iterator(code.begin()), std::make_move_iterator(code.end()));
+        code.clear();
+        return finish(start);
+    }
+    
+    // The generator only holds compiled code; run-time state lives in the
+    // caller's VM, so one program can be executed by several VMs.
+    size_t execute(VM& vm) {
+        vm.reset();
+        executed = program.code.size();
+        if (jitEnabled) {
+            if (!jitted.compiled() || jittedSize != program.code.size()) {
+                jitted.compile(program);
+                jittedSize = program.code.size();
+            }
+            jitted.run(vm.prepare(program), vm.printer(), vm.printerContext());
+        } else {
+            vm.run(program);
         }
-        std::stringstream ss;
-        for (size_t i = 0; i < instructions.size(); i++) {
-            ss << i + 1 << ": " << instructions[i].toString() << "\n";
+        return executed;
+    }
+    
+    // With a profiler the pending code is interpreted one instruction at a
+    // time, even when the JIT is enabled.
+    size_t executePending(VM& vm, Profiler* profiler = nullptr) {
+        size_t from = executed;
+        executed = program.code.size();
+        if (profiler) {
+            profiler->run(vm, program, from);
+        } else if (jitEnabled) {
+            JitFunction chunk;
+            chunk.compile(program, from);
+            chunk.run(vm.prepare(program), vm.printer(), vm.printerContext());
+        } else {
+            vm.run(program, from);
         }
-        return ss.str();
+        return executed - from;
     }
     
-    void execute() {
-        memory.clear();
-        for (const auto& inst : instructions) {
-            if (inst.op == "=") {
-                double value = (memory.find(inst.arg1) != memory.end()) ? 
-                               memory[inst.arg1] : std::stod(inst.arg1);
-                memory[inst.result] = value;
-            }
-            else if (inst.op == "print") {
-                double value = (memory.find(inst.arg1) != memory.end()) ? 
-                               memory[inst.arg1] : std::stod(inst.arg1);
-                std::cout << value << "\n";
-            }
-            else {
-                double left = (memory.find(inst.arg1) != memory.end()) ? 
-                              memory[inst.arg1] : std::stod(inst.arg1);
-                double right = (memory.find(inst.arg2) != memory.end()) ? 
-                               memory[inst.arg2] : std::stod(inst.arg2);
-                double result = 0;
-                if (inst.op == "+") result = left + right;
-                else if (inst.op == "-") result = left - right;
-                else if (inst.op == "*") result = left * right;
-                else if (inst.op == "/") {
-                    if (right == 0) throw std::runtime_error("Division por cero");
-                    result = left / right;
-                }
-                memory[inst.result] = result;
-            }
+    // Drops the IR and bytecode emitted so far while keeping the slots.
+    // Neither temps nor literals outlive the chunk that uses them, so later
+    // chunks reuse the same slots and a streaming compile stays bounded by
+    // the largest chunk, however long the script.
+    void flush() {
+        flushed += instructions.size();
+        instructions.clear();
+        program.code.clear();
+        program.locations.clear();
+        jitted = JitFunction();
+        executed = 0;
+    }
+    
+    void setJit(bool enabled) {
+        if (enabled && !JitFunction::supported()) {
+            throw std::runtime_error("JIT no disponible en esta plataforma");
         }
+        jitEnabled = enabled;
+    }
+    
+    bool jit() const {
+        return jitEnabled;
+    }
+    
+    // With listings off, generate and append return an empty string.
+    void setListing(bool enabled) {
+        listing = enabled;
+    }
+    
+    // 0 only reuses temp slots by liveness; N > 0 allocates temps onto N
+    // machine registers (%rK, kept in xmm by the JIT) and spills the rest.
+    void setRegisterFile(uint32_t size) {
+        allocator = RegisterAllocator(size);
+    }
+    
+    uint32_t registerFile() const {
+        return allocator.fileSize();
+    }
+    
+    const std::vector<Instruction>& getInstructions() const {
+        return instructions;
+    }
+    
+    const Program& getProgram() const {
+        return program;
+    }
+    
+    OptimizerOptions& optimizerOptions() {
+        return optimizer.options;
     }
 };
 
@@ -0,0 +1,259 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "minicompiler.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unistd.h>
+
+// Evaluates a script once per row of a CSV file. The header names the input
+// variables; each printed value becomes a field of the row's output line.
+// The mapped file is split into shards that end on a newline, workers take
+// them in file order with a frame of their own, and the calling thread
+// writes finished shards back in that order. Workers stay within a window of
+// shards ahead of the writer, so buffered output is bounded however large
+// the file is.
+class CsvEvaluator {
+private:
+    static constexpr size_t MIN_SHARD_BYTES = 64 << 10;
+    static constexpr size_t MAX_SHARD_BYTES = 1 << 20;
+    static constexpr size_t WINDOW_PER_THREAD = 2;
+    
+    struct Range {
+        size_t index, begin, end;
+    };
+    
+    struct Shard {
+        std::string output;
+        std::string error;
+        size_t errorOffset = 0;
+        size_t rows = 0;
+        bool done = false;
+    };
+    
+    struct RowSink {
+        std::string* output;
+        bool first;
+    };
+    
+    unsigned threads;
+    bool jit;
+    
+    static void printField(void* context, double value) {
+        RowSink& sink = *static_cast<RowSink*>(context);
+        char buffer[32];
+        char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        if (!sink.first) sink.output->push_back(',');
+        sink.output->append(buffer, end);
+        sink.first = false;
+    }
+    
+    static std::string_view trim(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+        return text;
+    }
+    
+    static bool isIdentifier(std::string_view name) {
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) return false;
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+        }
+        return true;
+    }
+    
+    static std::vector<std::string> header(std::string_view line) {
+        std::vector<std::string> names;
+        size_t start = 0;
+        while (true) {
+            size_t comma = line.find(',', start);
+            std::string_view name = trim(line.substr(start, comma == std::string_view::npos ? comma : comma - start));
+            if (!isIdentifier(name)) {
+                throw std::runtime_error("Error CSV: columna '" + std::string(name) + "' no es un nombre de variable valido");
+            }
+            for (const std::string& previous : names) {
+                if (previous == name) throw std::runtime_error("Error CSV: columna '" + previous + "' repetida");
+            }
+            names.emplace_back(name);
+            if (comma == std::string_view::npos) return names;
+            start = comma + 1;
+        }
+    }
+    
+    static void parseRow(std::string_view line, ProgramRunner& runner, const std::vector<Slot>& slots) {
+        size_t start = 0;
+        for (size_t k = 0; k < slots.size(); k++) {
+            size_t comma = line.find(',', start);
+            bool last = k + 1 == slots.size();
+            if (last != (comma == std::string_view::npos)) {
+                throw std::runtime_error("Error CSV: se esperaban " + std::to_string(slots.size()) + " campos");
+            }
+            std::string_view field = trim(line.substr(start, last ? std::string_view::npos : comma - start));
+            double value = 0;
+            auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+            if (field.empty() || result.ec != std::errc() || result.ptr != field.data() + field.size()) {
+                throw std::runtime_error("Error CSV: campo '" + std::string(field) + "' no es un numero");
+            }
+            runner.set(slots[k], value);
+            start = comma + 1;
+        }
+    }
+    
+    static void evaluate(std::string_view text, const Range& range, Shard& shard, ProgramRunner& runner,
+                         const std::vector<Slot>& slots) {
+        RowSink sink{&shard.output, true};
+        size_t position = range.begin;
+        try {
+            while (position < range.end) {
+                const void* newline = std::memchr(text.data() + position, '\n', range.end - position);
+                size_t lineEnd = newline ? static_cast<size_t>(static_cast<const char*>(newline) - text.data()) : range.end;
+                std::string_view line = trim(text.substr(position, lineEnd - position));
+                if (!line.empty()) {
+                    parseRow(line, runner, slots);
+                    sink.first = true;
+                    runner.run(printField, &sink);
+                    shard.output.push_back('\n');
+                    shard.rows++;
+                }
+                position = lineEnd + 1;
+            }
+        } catch (const std::exception& e) {
+            shard.error = e.what();
+            shard.errorOffset = position;
+        }
+    }
+    
+    std::vector<Range> split(std::string_view text, size_t begin) const {
+        size_t target = (text.size() - begin) / (static_cast<size_t>(threads) * 4);
+        target = std::min(std::max(target, MIN_SHARD_BYTES), MAX_SHARD_BYTES);
+        std::vector<Range> ranges;
+        while (begin < text.size()) {
+            size_t end = std::min(text.size(), begin + target);
+            const void* newline = end < text.size() ? std::memchr(text.data() + end, '\n', text.size() - end) : nullptr;
+            end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - text.data()) + 1 : text.size();
+            ranges.push_back({ranges.size(), begin, end});
+            begin = end;
+        }
+        return ranges;
+    }
+    
+public:
+    // `threadCount` 0 uses every hardware thread.
+    explicit CsvEvaluator(unsigned threadCount = 0, bool useJit = true)
+        : threads(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency())), jit(useJit) {}
+    
+    // Returns the number of rows evaluated. On error nothing after the
+    // first failing row is written, and the message names its line.
+    size_t run(std::string_view script, const std::string& path, std::ostream& out) {
+        MappedFile file(path);
+        std::string_view text = file.view();
+        size_t headerEnd = std::min(text.find('\n'), text.size());
+        std::vector<std::string> names = header(text.substr(0, headerEnd));
+        CompileOptions options;
+        options.jit = jit && JitFunction::supported();
+        options.keepVariables = false;
+        CompiledProgram program = compile(script, names, options);
+        
+        std::vector<Range> ranges = split(text, std::min(headerEnd + 1, text.size()));
+        std::vector<Shard> shards(ranges.size());
+        std::mutex lock;
+        std::condition_variable ready, advanced;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> failed{ranges.size()};
+        size_t written = 0;
+        size_t window = static_cast<size_t>(threads) * WINDOW_PER_THREAD;
+        
+        // Shards are taken in file order, so the first unwritten one is always
+        // held by a worker that is not waiting, and the writer keeps moving.
+        auto work = [&] {
+            ProgramRunner runner(program);
+            std::vector<Slot> slots;
+            for (const std::string& name : names) slots.push_back(runner.slot(name));
+            while (true) {
+                size_t index = next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= ranges.size()) break;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    advanced.wait(guard, [&] { return index < written + window; });
+                }
+                const Range& range = ranges[index];
+                Shard shard;
+                // Shards after a failed one are never written, so skip them.
+                if (range.index < failed.load(std::memory_order_relaxed)) evaluate(text, range, shard, runner, slots);
+                if (!shard.error.empty()) {
+                    size_t current = failed.load(std::memory_order_relaxed);
+                    while (range.index < current && !failed.compare_exchange_weak(current, range.index)) {}
+                }
+                shard.done = true;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    shards[range.index] = std::move(shard);
+                }
+                ready.notify_all();
+            }
+        };
+        std::vector<std::thread> workers;
+        size_t started = std::min<size_t>(threads, ranges.size());
+        for (size_t w = 0; w < started; w++) workers.emplace_back(work);
+        
+        size_t rows = 0;
+        std::string error;
+        for (Shard& slot : shards) {
+            Shard shard;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready.wait(guard, [&] { return slot.done; });
+                shard = std::move(slot);
+                written++;
+            }
+            advanced.notify_all();
+            out.write(shard.output.data(), static_cast<std::streamsize>(shard.output.size()));
+            rows += shard.rows;
+            if (!shard.error.empty()) {
+                size_t line = 1 + static_cast<size_t>(std::count(text.begin(), text.begin() + shard.errorOffset, '\n'));
+                error = shard.error + " (linea " + std::to_string(line) + ")";
+                break;
+            }
+        }
+        {
+            // After an error nothing more is written; let waiting workers
+            // run out the remaining shards, which they skip.
+            std::lock_guard<std::mutex> guard(lock);
+            written = ranges.size();
+        }
+        advanced.notify_all();
+        for (std::thread& worker : workers) worker.join();
+        if (!error.empty()) throw std::runtime_error(error);
+        return rows;
+    }
+    
+    // Output goes to a temporary file that only replaces `output` once every
+    // row has been evaluated, so a run that fails publishes nothing.
+    size_t runToFile(std::string_view script, const std::string& path, const std::string& output) {
+        std::string temporary = output + ".tmp." + std::to_string(getpid());
+        try {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Error: no se pudo crear '" + output + "'");
+            size_t rows = run(script, path, out);
+            out.close();
+            if (!out || std::rename(temporary.c_str(), output.c_str()) != 0) {
+                throw std::runtime_error("Error: no se pudo escribir '" + output + "'");
+            }
+            return rows;
+        } catch (...) {
+            std::remove(temporary.c_str());
+            throw;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "translator.h"
+#include "mapped_file.h"
+#include "cache.h"
+#include "stats.h"
+#include <memory>
+
+enum class BatchMode {
+    RUN, COMPILE, BUILD
+};
+
+// Non-interactive pipeline for script files: the source is memory-mapped
+// and lexed, parsed, analyzed and generated a chunk of statements at a
+// time, so peak memory does not depend on the size of the script.
+class BatchDriver {
+private:
+    static constexpr size_t CHUNK_STATEMENTS = 1024;
+    
+    Interner symbols;
+    SemanticAnalyzer semantic;
+    CodeGenerator codegen;
+    PrintBuffer output;
+    VM vm;
+    std::unique_ptr<BytecodeCache> cache;
+    std::string cacheDirectory;
+    Stats stats;
+    std::unique_ptr<Profiler> profiler;
+    bool sharing = false;
+    bool fused = false;
+    
+    void analyze(const Ast& chunk) {
+        semantic.analyze(chunk);
+    }
+    
+    void analyze(Translator& chunk) {
+        chunk.check();
+    }
+    
+    std::string generate(const Ast& chunk) {
+        return codegen.append(chunk);
+    }
+    
+    std::string generate(Translator& chunk) {
+        return codegen.append(std::move(chunk.instructions()));
+    }
+    
+    template <typename Builder>
+    void compile(BasicParser<Builder>& parser, Lexer& lexer, BatchMode mode, MappedFile* file, CacheWriter* writer) {
+        while (!parser.done()) {
+            size_t tokens = lexer.tokenCount();
+            Builder* chunk;
+            {
+                // Tokens are pulled while parsing, so lexing time is
+                // reported as part of the parser phase.
+                Stats::Scope scope = stats.measure(Phase::PARSER);
+                chunk = &parser.parseChunk(CHUNK_STATEMENTS);
+            }
+            stats.count(Phase::LEXER, lexer.tokenCount() - tokens);
+            stats.count(Phase::PARSER, chunk->size());
+            // Nothing reads the variables after the last chunk.
+            codegen.optimizerOptions().variablesLiveOut = !parser.done();
+            size_t defined = semantic.getSymbolTable().size();
+            {
+                Stats::Scope scope = stats.measure(Phase::SEMANTIC);
+                analyze(*chunk);
+            }
+            stats.count(Phase::SEMANTIC, semantic.getSymbolTable().size() - defined);
+            std::string listing;
+            {
+                Stats::Scope scope = stats.measure(Phase::CODEGEN);
+                listing = generate(*chunk);
+            }
+            stats.count(Phase::CODEGEN, codegen.getInstructions().size());
+            if (writer) writer->append(codegen.getProgram().code);
+            if (mode == BatchMode::RUN) {
+                Stats::Scope scope = stats.measure(Phase::EXECUTE);
+                stats.count(Phase::EXECUTE, codegen.executePending(vm, profiler.get()));
+            } else if (mode == BatchMode::COMPILE) {
+                std::cout << listing;
+            }
+            codegen.flush();
+            if (file) file->release(lexer.offset());
+        }
+    }
+    
+public:
+    BatchDriver() : semantic(symbols), codegen(symbols) {
+        vm.setPrinter(PrintBuffer::print, &output);
+    }
+    
+    // Runs of unchanged scripts execute the cached image in place instead of
+    // compiling; a miss compiles as usual and writes the image on success.
+    void setCache(const std::string& directory) {
+        cacheDirectory = directory;
+        cache = std::make_unique<BytecodeCache>(directory);
+    }
+    
+    // Printed values are buffered; flush before reporting anything else.
+    void flushOutput() {
+        output.flush();
+    }
+    
+    void enableProfiler() {
+        profiler = std::make_unique<Profiler>();
+    }
+    
+    // Repeated subexpressions within a chunk are parsed into one node and
+    // evaluated once.
+    void shareExpressions(bool enabled) {
+        sharing = enabled;
+    }
+    
+    // Compiles each chunk in a single pass from the token stream, with no
+    // Ast. Output and diagnostics are the same; expressions are not shared.
+    void setFused(bool enabled) {
+        fused = enabled;
+    }
+    
+    // Each chunk runs as native code compiled for it. Cached images still
+    // run on the VM.
+    void setJit(bool enabled) {
+        codegen.setJit(enabled);
+    }
+    
+    // 0 only reuses temp slots; N > 0 allocates temps onto N registers,
+    // which the JIT keeps in xmm.
+    void setRegisterFile(uint32_t size) {
+        codegen.setRegisterFile(size);
+    }
+    
+    void process(std::string_view source, BatchMode mode, MappedFile* file = nullptr, CacheWriter* writer = nullptr) {
+        Lexer lexer(source, symbols);
+        codegen.setListing(mode == BatchMode::COMPILE);
+        if (fused) {
+            BasicParser<Translator> parser(lexer, Translator(semantic));
+            compile(parser, lexer, mode, file, writer);
+        } else {
+            Parser parser(lexer);
+            parser.shareExpressions(sharing);
+            compile(parser, lexer, mode, file, writer);
+        }
+        if (writer && !writer->finish(codegen.getProgram(), symbols)) {
+            if (mode == BatchMode::BUILD) throw std::runtime_error("Error: no se pudo escribir la cache en '" + cacheDirectory + "'");
+            std::cerr << "Aviso: no se pudo escribir la cache en '" << cacheDirectory << "'\n";
+        }
+    }
+    
+    // Compiles into the cache without running or printing anything. Returns
+    // false when the cache already holds a current image of the file.
+    bool buildFile(const std::string& path) {
+        if (!cache) throw std::runtime_error("Error: compilar a la cache requiere un directorio");
+        MappedFile file(path);
+        uint64_t hash = BytecodeCache::key(file.view());
+        if (cache->load(hash, file.view().size())) return false;
+        std::unique_ptr<CacheWriter> writer = cache->writer(hash, file.view().size());
+        if (!writer) throw std::runtime_error("Error: no se pudo escribir la cache en '" + cacheDirectory + "'");
+        process(file.view(), BatchMode::BUILD, &file, writer.get());
+        return true;
+    }
+    
+    void processFile(const std::string& path, BatchMode mode) {
+        MappedFile file(path);
+        if (!cache || mode != BatchMode::RUN || profiler) {
+            process(file.view(), mode, &file);
+            return;
+        }
+        uint64_t hash = BytecodeCache::key(file.view());
+        if (std::unique_ptr<CachedProgram> cached = cache->load(hash, file.view().size())) {
+            Stats::Scope scope = stats.measure(Phase::EXECUTE);
+            vm.run(cached->view());
+            stats.count(Phase::EXECUTE, cached->view().codeSize);
+            return;
+        }
+        std::unique_ptr<CacheWriter> writer = cache->writer(hash, file.view().size());
+        if (!writer) std::cerr << "Aviso: no se pudo escribir la cache en '" << cacheDirectory << "'\n";
+        process(file.view(), mode, &file, writer.get());
+    }
+    
+    const Stats& getStats() const {
+        return stats;
+    }
+    
+    const Profiler* getProfiler() const {
+        return profiler.get();
+    }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef IR_H
+#define IR_H
+
+#include "symbols.h"
+#include <string>
+#include <charconv>
+#include <cstring>
+#include <functional>
+
+inline std::string formatNumber(double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+// TEMP, REGISTER and SPILL are the %tK, %rK and %sK of listings: temps
+// before register allocation and, after it, reused slots, machine
+// registers and spill slots.
+enum class OperandKind : uint8_t {
+    NONE, CONSTANT, VARIABLE, TEMP, REGISTER, SPILL
+};
+
+// A constant carries its value and a variable its SymbolId, so no pass
+// reads numbers or looks names up again. Constants compare by bit pattern,
+// so 0 and -0 stay distinct.
+struct Operand {
+    OperandKind kind = OperandKind::NONE;
+    uint32_t index = 0;
+    double value = 0;
+    
+    static Operand number(double value) {
+        Operand operand;
+        operand.kind = OperandKind::CONSTANT;
+        operand.value = value;
+        return operand;
+    }
+    
+    static Operand variable(SymbolId id) {
+        return {OperandKind::VARIABLE, id, 0};
+    }
+    
+    static Operand temp(uint32_t index) {
+        return {OperandKind::TEMP, index, 0};
+    }
+    
+    // Identity within its kind: the value's bits for a constant, the index
+    // for anything else.
+    uint64_t key() const {
+        if (kind != OperandKind::CONSTANT) return index;
+        uint64_t raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        return raw;
+    }
+    
+    bool operator==(const Operand& other) const {
+        return kind == other.kind && key() == other.key();
+    }
+    
+    bool operator!=(const Operand& other) const {
+        return !(*this == other);
+    }
+    
+    bool operator<(const Operand& other) const {
+        return kind != other.kind ? kind < other.kind : key() < other.key();
+    }
+    
+    std::string toString(const Interner& symbols) const {
+        switch (kind) {
+            case OperandKind::CONSTANT: return formatNumber(value);
+            case OperandKind::VARIABLE: return std::string(symbols.name(index));
+            case OperandKind::TEMP: return "%t" + std::to_string(index);
+            case OperandKind::REGISTER: return "%r" + std::to_string(index);
+            case OperandKind::SPILL: return "%s" + std::to_string(index);
+            case OperandKind::NONE: break;
+        }
+        return "";
+    }
+};
+
+struct OperandHash {
+    size_t operator()(const Operand& operand) const {
+        return std::hash<uint64_t>()(operand.key() * 8 + static_cast<uint64_t>(operand.kind));
+    }
+};
+
+struct Instruction {
+    std::string op;
+    Operand arg1, arg2, result;
+    SourceLocation location;
+    
+    std::string toString(const Interner& symbols) const {
+        if (op == "=") return result.toString(symbols) + " = " + arg1.toString(symbols);
+        if (op == "print") return "print " + arg1.toString(symbols);
+        return result.toString(symbols) + " = " + arg1.toString(symbols) + " " + op + " " + arg2.toString(symbols);
+    }
+};
+
+inline bool isTemp(const Operand& operand) {
+    return operand.kind >= OperandKind::TEMP;
+}
+
+inline bool isConstant(const Operand& operand) {
+    return operand.kind == OperandKind::CONSTANT;
+}
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define MINICOMPILER_JIT 1
+#include <sys/mman.h>
+#endif
+
+// Lowers bytecode to x86-64 SSE2. The generated function receives the VM
+// frame in rdi and returns 0, or 1 when a division by zero was detected.
+class JitFunction {
+private:
+    using Entry = int (*)(double* frame, PrintCallback print, void* context);
+    
+    static constexpr int FIRST_MACHINE = 3;
+    
+    void* memory;
+    size_t capacity;
+    std::vector<uint8_t> buffer;
+    std::vector<int8_t> homes;
+    
+    void emit(std::initializer_list<uint8_t> bytes) {
+        buffer.insert(buffer.end(), bytes);
+    }
+    
+    void emit32(int32_t value) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, 4);
+        buffer.insert(buffer.end(), bytes, bytes + 4);
+    }
+    
+    static int32_t offset(Slot slot) {
+        const Slot limit = std::numeric_limits<int32_t>::max() / 8;
+        if (slot > limit || slot < -limit) {
+            throw std::runtime_error("JIT: demasiadas variables");
+        }
+        return slot * 8;
+    }
+    
+    // <prefix> [REX] 0F <opcode> modrm(xmm, [rbx + disp32])
+    void sse(uint8_t prefix, uint8_t opcode, int xmm, Slot slot) {
+        emit({prefix});
+        if (xmm >= 8) emit({0x44});
+        emit({0x0F, opcode, static_cast<uint8_t>(0x83 | ((xmm & 7) << 3))});
+        emit32(offset(slot));
+    }
+    
+    // <prefix> [REX] 0F <opcode> modrm(xmm, xmm)
+    void sseRegister(uint8_t prefix, uint8_t opcode, int xmm, int source) {
+        emit({prefix});
+        if (xmm >= 8 || source >= 8) emit({static_cast<uint8_t>(0x40 | (xmm >= 8 ? 4 : 0) | (source >= 8 ? 1 : 0))});
+        emit({0x0F, opcode, static_cast<uint8_t>(0xC0 | ((xmm & 7) << 3) | (source & 7))});
+    }
+    
+    int machine(Slot slot) const {
+        if (slot >= 0 || static_cast<size_t>(-1 - slot) >= homes.size()) return -1;
+        return homes[static_cast<size_t>(-1 - slot)];
+    }
+    
+    void operand(uint8_t opcode, int xmm, Slot slot) {
+        int source = machine(slot);
+        if (source >= 0) sseRegister(0xF2, opcode, xmm, source);
+        else sse(0xF2, opcode, xmm, slot);
+    }
+    
+    void load(int xmm, Slot slot) { operand(0x10, xmm, slot); }
+    
+    void store(Slot slot) {
+        int target = machine(slot);
+        if (target >= 0) sseRegister(0xF2, 0x10, target, 0);
+        else sse(0xF2, 0x11, 0, slot);
+    }
+    
+    // Register-resident temps go to their frame slot around calls, since
+    // every xmm register is caller-saved.
+    void preserve(uint32_t live, const Program& program, bool save) {
+        for (uint32_t k = 0; k < MACHINE_REGISTERS; k++) {
+            if (live & (1u << k)) sse(0xF2, save ? 0x11 : 0x10, FIRST_MACHINE + static_cast<int>(k), program.machineSlots[k]);
+        }
+    }
+    
+    uint32_t bit(Slot slot) const {
+        int xmm = machine(slot);
+        return xmm < 0 ? 0 : 1u << (xmm - FIRST_MACHINE);
+    }
+    
+    void release() {
+#ifdef MINICOMPILER_JIT
+        if (memory) munmap(memory, capacity);
+#endif
+        memory = nullptr;
+        capacity = 0;
+    }
+    
+public:
+    // xmm0-xmm2 are scratch; %r0..%r12 live in xmm3-xmm15.
+    static constexpr uint32_t MACHINE_REGISTERS = 13;
+    
+    JitFunction() : memory(nullptr), capacity(0) {}
+    ~JitFunction() { release(); }
+    
+    JitFunction(const JitFunction&) = delete;
+    JitFunction& operator=(const JitFunction&) = delete;
+    
+    JitFunction(JitFunction&& other) noexcept : memory(other.memory), capacity(other.capacity) {
+        other.memory = nullptr;
+        other.capacity = 0;
+    }
+    
+    JitFunction& operator=(JitFunction&& other) noexcept {
+        if (this != &other) {
+            release();
+            memory = other.memory;
+            capacity = other.capacity;
+            other.memory = nullptr;
+            other.capacity = 0;
+        }
+        return *this;
+    }
+    
+    static bool supported() {
+#ifdef MINICOMPILER_JIT
+        return true;
+#else
+        return false;
+#endif
+    }
+    
+    bool compiled() const {
+        return memory != nullptr;
+    }
+    
+    void compile(const Program& program, size_t from = 0) {
+#ifdef MINICOMPILER_JIT
+        buffer.clear();
+        buffer.reserve((program.code.size() - from) * 24 + 64);
+        std::vector<size_t> errorJumps;
+        
+        emit({0x53, 0x41, 0x54, 0x41, 0x55});          // push rbx; push r12; push r13
+        emit({0x48, 0x89, 0xFB});                      // mov rbx, rdi
+        emit({0x49, 0x89, 0xF4});                      // mov r12, rsi
+        emit({0x49, 0x89, 0xD5});                      // mov r13, rdx
+        
+        homes.assign(program.registerCount(), -1);
+        for (size_t k = 0; k < program.machineSlots.size() && k < MACHINE_REGISTERS; k++) {
+            Slot slot = program.machineSlots[k];
+            if (slot < 0) homes[static_cast<size_t>(-1 - slot)] = static_cast<int8_t>(FIRST_MACHINE + k);
+        }
+        std::vector<uint32_t> liveAfter(program.code.size() - from);
+        uint32_t live = 0;
+        for (size_t i = program.code.size(); i-- > from;) {
+            const Bytecode& inst = program.code[i];
+            liveAfter[i - from] = live;
+            if (inst.op == OpCode::LOAD) {
+                live &= ~bit(inst.dst);
+                continue;
+            }
+            if (inst.op != OpCode::PRINT) live &= ~bit(inst.dst);
+            live |= bit(inst.a);
+            if (inst.op != OpCode::MOVE && inst.op != OpCode::PRINT) live |= bit(inst.b);
+        }
+        
+        for (size_t i = from; i < program.code.size(); i++) {
+            const Bytecode& inst = program.code[i];
+            switch (inst.op) {
+                case OpCode::MOVE: {
+                    int target = machine(inst.dst);
+                    if (target >= 0) {
+                        load(target, inst.a);
+                    } else {
+                        load(0, inst.a);
+                        store(inst.dst);
+                    }
+                    break;
+                }
+                case OpCode::ADD:
+                case OpCode::SUB:
+                case OpCode::MUL: {
+                    uint8_t opcode = inst.op == OpCode::ADD ? 0x58 : inst.op == OpCode::SUB ? 0x5C : 0x59;
+                    load(0, inst.a);
+                    operand(opcode, 0, inst.b);
+                    store(inst.dst);
+                    break;
+                }
+                case OpCode::DIV:
+                    load(0, inst.a);
+                    load(1, inst.b);
+                    emit({0x66, 0x0F, 0x57, 0xD2});        // xorpd xmm2, xmm2
+                    emit({0x66, 0x0F, 0x2E, 0xCA});        // ucomisd xmm1, xmm2
+                    emit({0x7A, 0x07, 0x75, 0x05, 0xE9});  // jp ok; jne ok; jmp error
+                    errorJumps.push_back(buffer.size());
+                    emit32(0);
+                    emit({0xF2, 0x0F, 0x5E, 0xC1});        // ok: divsd xmm0, xmm1
+                    store(inst.dst);
+                    break;
+                case OpCode::PRINT:
+                    load(0, inst.a);
+                    preserve(liveAfter[i - from], program, true);
+                    emit({0x4C, 0x89, 0xEF});              // mov rdi, r13
+                    emit({0x41, 0xFF, 0xD4});              // call r12
+                    preserve(liveAfter[i - from], program, false);
+                    break;
+                case OpCode::LOAD: {
+                    emit({0x48, 0xB8});                    // mov rax, imm64
+                    emit32(inst.a);
+                    emit32(inst.b);
+                    int target = machine(inst.dst);
+                    if (target >= 0) {
+                        // movq xmm, rax
+                        emit({0x66, static_cast<uint8_t>(target >= 8 ? 0x4C : 0x48), 0x0F, 0x6E,
+                              static_cast<uint8_t>(0xC0 | ((target & 7) << 3))});
+                    } else {
+                        emit({0x48, 0x89, 0x83});          // mov [rbx + disp32], rax
+                        emit32(offset(inst.dst));
+                    }
+                    break;
+                }
+            }
+        }
+        
+        emit({0x31, 0xC0});                            // xor eax, eax
+        emit({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});    // pop r13; pop r12; pop rbx; ret
+        size_t error = buffer.size();
+        emit({0xB8, 0x01, 0x00, 0x00, 0x00});          // mov eax, 1
+        emit({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+        for (size_t at : errorJumps) {
+            int32_t rel = static_cast<int32_t>(error - (at + 4));
+            std::memcpy(&buffer[at], &rel, 4);
+        }
+        
+        release();
+        size_t size = buffer.size();
+        void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) throw std::runtime_error("JIT: no se pudo reservar memoria");
+        std::memcpy(block, buffer.data(), size);
+        if (mprotect(block, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(block, size);
+            throw std::runtime_error("JIT: no se pudo marcar el codigo como ejecutable");
+        }
+        memory = block;
+        capacity = size;
+        buffer.clear();
+        buffer.shrink_to_fit();
+        homes.clear();
+#else
+        (void)program;
+        (void)from;
+        throw std::runtime_error("JIT no disponible en esta plataforma");
+#endif
+    }
+    
+    void run(double* frame, PrintCallback print = printToStdout, void* context = nullptr) const {
+        Entry entry = reinterpret_cast<Entry>(memory);
+        if (entry(frame, print, context) != 0) throw std::runtime_error("Division por cero");
+    }
+};
+
+#endif
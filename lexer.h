@@ -1,11 +1,14 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "symbols.h"
 #include <string>
 #include <vector>
-#include <cctype>
+#include <string_view>
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <stdexcept>
-#include <map>
 
 enum class TokenType {
     NUMBER, IDENTIFIER,
@@ -15,6 +18,25 @@ enum class TokenType {
     END_OF_FILE, UNKNOWN
 };
 
+inline const char* tokenTypeName(TokenType type) {
+    switch (type) {
+        case TokenType::NUMBER: return "NUMBER";
+        case TokenType::IDENTIFIER: return "IDENTIFIER";
+        case TokenType::PLUS: return "PLUS";
+        case TokenType::MINUS: return "MINUS";
+        case TokenType::MULTIPLY: return "MULTIPLY";
+        case TokenType::DIVIDE: return "DIVIDE";
+        case TokenType::ASSIGN: return "ASSIGN";
+        case TokenType::LPAREN: return "LPAREN";
+        case TokenType::RPAREN: return "RPAREN";
+        case TokenType::SEMICOLON: return "SEMICOLON";
+        case TokenType::PRINT: return "PRINT";
+        case TokenType::END_OF_FILE: return "EOF";
+        case TokenType::UNKNOWN: return "UNKNOWN";
+    }
+    return "UNKNOWN";
+}
+
 struct Token {
     TokenType type;
     std::string lexeme;
@@ -24,90 +46,171 @@ struct Token {
         : type(t), lexeme(lex), line(l), column(c) {}
     
     std::string toString() const {
-        static std::map<TokenType, std::string> typeNames = {
-            {TokenType::NUMBER, "NUMBER"}, {TokenType::IDENTIFIER, "IDENTIFIER"},
-            {TokenType::PLUS, "PLUS"}, {TokenType::MINUS, "MINUS"},
-            {TokenType::MULTIPLY, "MULTIPLY"}, {TokenType::DIVIDE, "DIVIDE"},
-            {TokenType::ASSIGN, "ASSIGN"}, {TokenType::LPAREN, "LPAREN"},
-            {TokenType::RPAREN, "RPAREN"}, {TokenType::SEMICOLON, "SEMICOLON"},
-            {TokenType::PRINT, "PRINT"}, {TokenType::END_OF_FILE, "EOF"}
-        };
-        return typeNames[type] + " '" + lexeme + "' [" + 
+        return std::string(tokenTypeName(type)) + " '" + lexeme + "' [" + 
                std::to_string(line) + ":" + std::to_string(column) + "]";
     }
 };
 
+struct TokenView {
+    TokenType type;
+    uint32_t length;
+    size_t offset;
+    int line, column;
+    SymbolId symbol;
+};
+
+enum CharClass : uint8_t {
+    CHAR_SPACE = 1, CHAR_DIGIT = 2, CHAR_IDENT_START = 4, CHAR_IDENT = 8, CHAR_NUMBER = 16
+};
+
+constexpr std::array<uint8_t, 256> makeCharTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c : {' ', '\t', '\n', '\v', '\f', '\r'}) table[c] = CHAR_SPACE;
+    for (int c = '0'; c <= '9'; c++) table[c] = CHAR_DIGIT | CHAR_IDENT | CHAR_NUMBER;
+    for (int c = 'a'; c <= 'z'; c++) table[c] = CHAR_IDENT_START | CHAR_IDENT;
+    for (int c = 'A'; c <= 'Z'; c++) table[c] = CHAR_IDENT_START | CHAR_IDENT;
+    table['_'] = CHAR_IDENT_START | CHAR_IDENT;
+    table['.'] = CHAR_NUMBER;
+    return table;
+}
+
+constexpr std::array<TokenType, 256> makePunctTable() {
+    std::array<TokenType, 256> table{};
+    for (auto& type : table) type = TokenType::UNKNOWN;
+    table['+'] = TokenType::PLUS;
+    table['-'] = TokenType::MINUS;
+    table['*'] = TokenType::MULTIPLY;
+    table['/'] = TokenType::DIVIDE;
+    table['='] = TokenType::ASSIGN;
+    table['('] = TokenType::LPAREN;
+    table[')'] = TokenType::RPAREN;
+    table[';'] = TokenType::SEMICOLON;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> charTable = makeCharTable();
+constexpr std::array<TokenType, 256> punctTable = makePunctTable();
+
+// Reads a literal with std::from_chars, which must consume all of `text`.
+// std::stod used to accept a prefix, reading `1.2.3` as 1.2; rejecting the
+// second '.' is deliberate. A value that overflows a double or underflows to
+// zero is rejected too.
+inline std::errc readNumber(std::string_view text, double& value) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, value);
+    if (result.ec != std::errc()) return result.ec;
+    return result.ptr == end ? std::errc() : std::errc::invalid_argument;
+}
+
+inline std::string numberError(std::string_view text, std::errc error) {
+    return "Error lexico: numero '" + std::string(text) + "'" +
+           (error == std::errc::result_out_of_range ? " fuera de rango" : " no valido");
+}
+
+inline double parseNumber(std::string_view text) {
+    double value = 0;
+    std::errc error = readNumber(text, value);
+    if (error != std::errc()) throw std::runtime_error(numberError(text, error));
+    return value;
+}
+
 class Lexer {
 private:
-    std::string source;
+    std::string_view source;
+    Interner& symbols;
     size_t position;
+    size_t produced;
     int line, column;
     
-    char current() const {
-        return (position >= source.length()) ? '\0' : source[position];
+    uint8_t charClass(size_t pos) const {
+        return charTable[static_cast<unsigned char>(source[pos])];
     }
     
-    void advance() {
-        if (position < source.length()) {
+    void skipWhitespace() {
+        while (position < source.size() && (charClass(position) & CHAR_SPACE)) {
             if (source[position] == '\n') { line++; column = 1; }
             else { column++; }
             position++;
         }
     }
     
-    void skipWhitespace() {
-        while (std::isspace(current())) advance();
+    void scanWhile(uint8_t mask) {
+        while (position < source.size() && (charClass(position) & mask)) position++;
     }
     
-    Token number() {
-        int startCol = column;
-        std::string num;
-        while (std::isdigit(current()) || current() == '.') {
-            num += current();
-            advance();
+public:
+    Lexer(std::string_view src, Interner& interner)
+        : source(src), symbols(interner), position(0), produced(0), line(1), column(1) {}
+    
+    TokenView next() {
+        skipWhitespace();
+        produced++;
+        if (position >= source.size()) {
+            return {TokenType::END_OF_FILE, 0, position, line, column, 0};
+        }
+        
+        size_t start = position;
+        unsigned char ch = static_cast<unsigned char>(source[position]);
+        TokenType type;
+        SymbolId symbol = 0;
+        
+        if (charTable[ch] & CHAR_DIGIT) {
+            scanWhile(CHAR_NUMBER);
+            type = TokenType::NUMBER;
         }
-        return Token(TokenType::NUMBER, num, line, startCol);
+        else if (charTable[ch] & CHAR_IDENT_START) {
+            scanWhile(CHAR_IDENT);
+            std::string_view word = source.substr(start, position - start);
+            type = word == "print" ? TokenType::PRINT : TokenType::IDENTIFIER;
+            if (type == TokenType::IDENTIFIER) symbol = symbols.intern(word);
+        }
+        else {
+            type = punctTable[ch];
+            if (type == TokenType::UNKNOWN) {
+                throw std::runtime_error("Error lexico: caracter '" + std::string(1, source[position]) + 
+                                       "' en linea " + std::to_string(line));
+            }
+            position++;
+        }
+        
+        TokenView tok{type, static_cast<uint32_t>(position - start), start, line, column, symbol};
+        column += static_cast<int>(position - start);
+        return tok;
     }
     
-    Token identifier() {
-        int startCol = column;
-        std::string id;
-        while (std::isalnum(current()) || current() == '_') {
-            id += current();
-            advance();
-        }
-        if (id == "print") return Token(TokenType::PRINT, id, line, startCol);
-        return Token(TokenType::IDENTIFIER, id, line, startCol);
+    size_t offset() const {
+        return position;
     }
     
-public:
-    Lexer(const std::string& src) : source(src), position(0), line(1), column(1) {}
+    size_t tokenCount() const {
+        return produced;
+    }
+    
+    const Interner& getSymbols() const {
+        return symbols;
+    }
+    
+    std::string_view getSource() const {
+        return source;
+    }
+    
+    std::string_view text(const TokenView& tok) const {
+        return source.substr(tok.offset, tok.length);
+    }
+    
+    std::vector<TokenView> scan() {
+        std::vector<TokenView> tokens;
+        do {
+            tokens.push_back(next());
+        } while (tokens.back().type != TokenType::END_OF_FILE);
+        return tokens;
+    }
     
     std::vector<Token> tokenize() {
         std::vector<Token> tokens;
-        while (position < source.length()) {
-            skipWhitespace();
-            if (position >= source.length()) break;
-            
-            char ch = current();
-            int col = column;
-            
-            if (std::isdigit(ch)) tokens.push_back(number());
-            else if (std::isalpha(ch) || ch == '_') tokens.push_back(identifier());
-            else if (ch == '+') { tokens.push_back(Token(TokenType::PLUS, "+", line, col)); advance(); }
-            else if (ch == '-') { tokens.push_back(Token(TokenType::MINUS, "-", line, col)); advance(); }
-            else if (ch == '*') { tokens.push_back(Token(TokenType::MULTIPLY, "*", line, col)); advance(); }
-            else if (ch == '/') { tokens.push_back(Token(TokenType::DIVIDE, "/", line, col)); advance(); }
-            else if (ch == '=') { tokens.push_back(Token(TokenType::ASSIGN, "=", line, col)); advance(); }
-            else if (ch == '(') { tokens.push_back(Token(TokenType::LPAREN, "(", line, col)); advance(); }
-            else if (ch == ')') { tokens.push_back(Token(TokenType::RPAREN, ")", line, col)); advance(); }
-            else if (ch == ';') { tokens.push_back(Token(TokenType::SEMICOLON, ";", line, col)); advance(); }
-            else {
-                throw std::runtime_error("Error lexico: caracter '" + std::string(1, ch) + 
-                                       "' en linea " + std::to_string(line));
-            }
+        for (const TokenView& tok : scan()) {
+            tokens.emplace_back(tok.type, std::string(text(tok)), tok.line, tok.column);
         }
-        tokens.push_back(Token(TokenType::END_OF_FILE, "", line, column));
         return tokens;
     }
 };
@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile {
+private:
+    void* data;
+    size_t size;
+    
+public:
+    explicit MappedFile(const std::string& path) : data(nullptr), size(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Error: no se pudo abrir '" + path + "'");
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Error: no se pudo leer '" + path + "'");
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size > 0) {
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                data = nullptr;
+                ::close(fd);
+                throw std::runtime_error("Error: no se pudo mapear '" + path + "'");
+            }
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+    
+    ~MappedFile() {
+        if (data) munmap(data, size);
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // Hints that the pages before `offset` will not be read again. The
+    // mapping is read-only, so touching them later just faults them back in.
+    void release(size_t offset) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t length = offset / page * page;
+        if (data && length > 0) madvise(data, length, MADV_DONTNEED);
+    }
+    
+    std::string_view view() const {
+        return std::string_view(static_cast<const char*>(data), size);
+    }
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef MINICOMPILER_H
+#define MINICOMPILER_H
+
+// Embedding interface: compile a script once, then run it any number of
+// times, from any number of threads, with host-supplied input values.
+//
+//   CompiledProgram rules = compile("total = precio * cantidad; print(total);", {"precio", "cantidad"});
+//   RunResult result = run(rules, {{"precio", 2.5}, {"cantidad", 4}}, [](double v) { ... });
+//   double total = result.get("total");
+//
+// Errors are reported as std::runtime_error; nothing is written to the
+// standard streams.
+
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "jit.h"
+#include <exception>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+struct CompileOptions {
+    bool optimize = true;
+    bool jit = false;
+    uint32_t registerFile = 0;
+    bool shareExpressions = false;
+    // With this off the host only reads what the program prints: stores to
+    // variables no print reads are removed, and RunResult reports 0 for them.
+    bool keepVariables = true;
+};
+
+using Bindings = std::unordered_map<std::string, double>;
+using PrintSink = std::function<void(double)>;
+
+class CompiledProgram;
+class RunResult;
+class ProgramRunner;
+
+// `inputs` are declared as numbers before analysis, so the script may read
+// them without assigning them first; their values come from run().
+inline CompiledProgram compile(std::string_view source, const std::vector<std::string>& inputs = {},
+                               const CompileOptions& options = {});
+
+// Each call uses its own frame, so one program can run on many threads.
+// Printed values go to `sink`; without one they are discarded.
+inline RunResult run(const CompiledProgram& compiled, const Bindings& bindings = {}, const PrintSink& sink = {});
+
+// Immutable once compiled; copies share the same code.
+class CompiledProgram {
+private:
+    struct Image {
+        Interner symbols;
+        Program program;
+        std::vector<SymbolId> inputs;
+        JitFunction native;
+    };
+    
+    std::shared_ptr<const Image> image;
+    
+    explicit CompiledProgram(std::shared_ptr<const Image> compiled) : image(std::move(compiled)) {}
+    
+    friend CompiledProgram compile(std::string_view, const std::vector<std::string>&, const CompileOptions&);
+    friend class RunResult;
+    friend class ProgramRunner;
+    friend RunResult run(const CompiledProgram&, const Bindings&, const PrintSink&);
+    
+public:
+    bool hasVariable(const std::string& name) const {
+        SymbolId id;
+        return image->symbols.find(name, id);
+    }
+    
+    std::vector<std::string> inputs() const {
+        std::vector<std::string> names;
+        for (SymbolId id : image->inputs) names.emplace_back(image->symbols.name(id));
+        return names;
+    }
+    
+    size_t instructionCount() const {
+        return image->program.code.size();
+    }
+};
+
+class RunResult {
+private:
+    std::shared_ptr<const CompiledProgram::Image> image;
+    std::vector<double> values;
+    
+    friend RunResult run(const CompiledProgram&, const Bindings&, const PrintSink&);
+    
+public:
+    double get(const std::string& name) const {
+        SymbolId id;
+        if (!image->symbols.find(name, id) || id >= values.size()) {
+            throw std::runtime_error("Error: variable '" + name + "' no existe en el programa");
+        }
+        return values[id];
+    }
+    
+    // Every variable of the program with its final value, in symbol order.
+    std::vector<std::pair<std::string, double>> variables() const {
+        std::vector<std::pair<std::string, double>> all;
+        all.reserve(values.size());
+        for (SymbolId id = 0; id < values.size(); id++) {
+            all.emplace_back(std::string(image->symbols.name(id)), values[id]);
+        }
+        return all;
+    }
+};
+
+// Runs one program over and over with a frame of its own: look up the
+// slots once, then set inputs and run per evaluation. Not thread-safe;
+// each thread keeps its own runner.
+class ProgramRunner {
+private:
+    // JIT frames carry no unwind information, so an exception thrown by the
+    // print callback must not cross them: it is kept here, later prints are
+    // skipped, and it is rethrown once the native code has returned.
+    struct Trampoline {
+        PrintCallback print;
+        void* context;
+        std::exception_ptr error;
+        
+        static void call(void* self, double value) {
+            Trampoline& trampoline = *static_cast<Trampoline*>(self);
+            if (trampoline.error) return;
+            try {
+                trampoline.print(trampoline.context, value);
+            } catch (...) {
+                trampoline.error = std::current_exception();
+            }
+        }
+    };
+    
+    std::shared_ptr<const CompiledProgram::Image> image;
+    VM vm;
+    double* frame;
+    
+public:
+    explicit ProgramRunner(const CompiledProgram& compiled)
+        : image(compiled.image), frame(vm.prepare(image->program)) {}
+    
+    ProgramRunner(const ProgramRunner&) = delete;
+    ProgramRunner& operator=(const ProgramRunner&) = delete;
+    
+    Slot slot(const std::string& name) const {
+        SymbolId id;
+        if (!image->symbols.find(name, id) || id >= image->program.variableCount) {
+            throw std::runtime_error("Error: variable '" + name + "' no existe en el programa");
+        }
+        return static_cast<Slot>(id);
+    }
+    
+    void set(Slot slot, double value) {
+        frame[slot] = value;
+    }
+    
+    double get(Slot slot) const {
+        return frame[slot];
+    }
+    
+    void run(PrintCallback print, void* context) {
+        if (image->native.compiled()) {
+            Trampoline trampoline{print, context, nullptr};
+            try {
+                image->native.run(frame, Trampoline::call, &trampoline);
+            } catch (...) {
+                if (!trampoline.error) throw;
+            }
+            if (trampoline.error) std::rethrow_exception(trampoline.error);
+            return;
+        }
+        vm.setPrinter(print, context);
+        vm.run(image->program);
+    }
+};
+
+inline CompiledProgram compile(std::string_view source, const std::vector<std::string>& inputs, const CompileOptions& options) {
+    auto image = std::make_shared<CompiledProgram::Image>();
+    SemanticAnalyzer semantic(image->symbols);
+    for (const std::string& name : inputs) {
+        semantic.declare(name);
+        image->inputs.push_back(image->symbols.intern(name));
+    }
+    Lexer lexer(source, image->symbols);
+    Parser parser(source, lexer.scan(), image->symbols);
+    parser.shareExpressions(options.shareExpressions);
+    Ast statements = parser.parse();
+    semantic.analyze(statements);
+    
+    CodeGenerator codegen(image->symbols);
+    codegen.optimizerOptions().enabled = options.optimize;
+    codegen.optimizerOptions().variablesLiveOut = options.keepVariables;
+    codegen.setRegisterFile(options.registerFile);
+    codegen.generate(statements);
+    image->program = codegen.getProgram();
+    image->program.variableCount = static_cast<uint32_t>(image->symbols.size());
+    if (options.jit) image->native.compile(image->program);
+    return CompiledProgram(std::move(image));
+}
+
+inline RunResult run(const CompiledProgram& compiled, const Bindings& bindings, const PrintSink& sink) {
+    ProgramRunner runner(compiled);
+    for (const auto& [name, value] : bindings) runner.set(runner.slot(name), value);
+    PrintCallback print = [](void* context, double value) {
+        const PrintSink& target = *static_cast<const PrintSink*>(context);
+        if (target) target(value);
+    };
+    runner.run(print, const_cast<PrintSink*>(&sink));
+    
+    RunResult result;
+    result.image = compiled.image;
+    uint32_t count = compiled.image->program.variableCount;
+    result.values.resize(count);
+    for (uint32_t id = 0; id < count; id++) result.values[id] = runner.get(static_cast<Slot>(id));
+    return result;
+}
+
+#endif
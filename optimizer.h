@@ -0,0 +1,242 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ir.h"
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct OptimizerOptions {
+    bool enabled = true;
+    bool constantFolding = true;
+    bool algebraic = true;
+    bool cse = true;
+    bool copyPropagation = true;
+    bool deadStores = true;
+    // Whether variables are read after the code, as by later REPL lines or
+    // batch chunks. Clear it for the end of a program, so dead-store
+    // elimination also drops stores to variables no print reads.
+    bool variablesLiveOut = true;
+    bool dumpIR = false;
+    std::ostream* dumpStream = &std::cerr;
+};
+
+class Optimizer {
+private:
+    // An arithmetic instruction's operator and operands, as CSE looks it up.
+    struct Expression {
+        char op;
+        Operand left, right;
+        
+        bool operator==(const Expression& other) const {
+            return op == other.op && left == other.left && right == other.right;
+        }
+    };
+    
+    struct ExpressionHash {
+        size_t operator()(const Expression& key) const {
+            OperandHash hash;
+            return (hash(key.left) * 31 + hash(key.right)) * 31 + static_cast<unsigned char>(key.op);
+        }
+    };
+    
+    using Values = std::unordered_map<Operand, Operand, OperandHash>;
+    using Available = std::unordered_map<Expression, Operand, ExpressionHash>;
+    using Dependents = std::unordered_map<Operand, std::vector<Expression>, OperandHash>;
+    using Users = std::unordered_map<Operand, std::vector<Operand>, OperandHash>;
+    
+    static bool isArithmetic(const Instruction& inst) {
+        return inst.op == "+" || inst.op == "-" || inst.op == "*" || inst.op == "/";
+    }
+    
+    static bool isConstantValue(const Operand& operand, double value) {
+        return isConstant(operand) && operand.value == value;
+    }
+    
+    static bool mayFail(const Instruction& inst) {
+        return inst.op == "/" && !(isConstant(inst.arg2) && inst.arg2.value != 0);
+    }
+    
+    static void substitute(Operand& operand, const Values& values) {
+        if (isConstant(operand)) return;
+        auto it = values.find(operand);
+        if (it != values.end()) operand = it->second;
+    }
+    
+    static void forget(const Operand& name, Dependents& dependents, Available& available) {
+        auto it = dependents.find(name);
+        if (it == dependents.end()) return;
+        for (const Expression& key : it->second) available.erase(key);
+        dependents.erase(it);
+    }
+    
+    static void foldConstants(std::vector<Instruction>& code) {
+        Values known;
+        for (Instruction& inst : code) {
+            substitute(inst.arg1, known);
+            if (isArithmetic(inst)) substitute(inst.arg2, known);
+            if (isArithmetic(inst) && isConstant(inst.arg1) && isConstant(inst.arg2)) {
+                double left = inst.arg1.value;
+                double right = inst.arg2.value;
+                if (inst.op != "/" || right != 0) {
+                    double value = inst.op == "+" ? left + right :
+                                   inst.op == "-" ? left - right :
+                                   inst.op == "*" ? left * right : left / right;
+                    if (std::isfinite(value)) inst = {"=", Operand::number(value), {}, inst.result, inst.location};
+                }
+            }
+            if (inst.op == "print") continue;
+            if (inst.op == "=" && isConstant(inst.arg1)) known[inst.result] = inst.arg1;
+            else known.erase(inst.result);
+        }
+    }
+    
+    static void simplifyAlgebra(std::vector<Instruction>& code) {
+        for (Instruction& inst : code) {
+            if (!isArithmetic(inst)) continue;
+            if ((inst.op == "*" || inst.op == "/") && isConstantValue(inst.arg2, 1)) {
+                inst = {"=", inst.arg1, {}, inst.result, inst.location};
+            }
+            else if (inst.op == "-" && isConstantValue(inst.arg2, 0)) {
+                inst = {"=", inst.arg1, {}, inst.result, inst.location};
+            }
+            else if (inst.op == "*" && isConstantValue(inst.arg1, 1)) {
+                inst = {"=", inst.arg2, {}, inst.result, inst.location};
+            }
+        }
+    }
+    
+    static void eliminateCommonSubexpressions(std::vector<Instruction>& code) {
+        Available available;
+        Dependents dependents;
+        for (Instruction& inst : code) {
+            if (inst.op == "print") continue;
+            Expression key{};
+            if (isArithmetic(inst)) {
+                const Operand* a = &inst.arg1;
+                const Operand* b = &inst.arg2;
+                if ((inst.op == "+" || inst.op == "*") && *b < *a) std::swap(a, b);
+                key = {inst.op[0], *a, *b};
+                auto it = available.find(key);
+                if (it != available.end()) inst = {"=", it->second, {}, inst.result, inst.location};
+            }
+            forget(inst.result, dependents, available);
+            if (isArithmetic(inst) && inst.result != inst.arg1 && inst.result != inst.arg2) {
+                available[key] = inst.result;
+                dependents[inst.result].push_back(key);
+                if (!isConstant(inst.arg1)) dependents[inst.arg1].push_back(key);
+                if (!isConstant(inst.arg2)) dependents[inst.arg2].push_back(key);
+            }
+        }
+    }
+    
+    static void propagateCopies(std::vector<Instruction>& code) {
+        Values copies;
+        Users users;
+        std::vector<Instruction> out;
+        out.reserve(code.size());
+        for (Instruction& inst : code) {
+            substitute(inst.arg1, copies);
+            if (isArithmetic(inst)) substitute(inst.arg2, copies);
+            if (inst.op != "print") {
+                copies.erase(inst.result);
+                auto it = users.find(inst.result);
+                if (it != users.end()) {
+                    for (const Operand& name : it->second) {
+                        auto copy = copies.find(name);
+                        if (copy != copies.end() && copy->second == inst.result) copies.erase(copy);
+                    }
+                    users.erase(it);
+                }
+                if (inst.op == "=") {
+                    if (inst.arg1 == inst.result) continue;
+                    copies[inst.result] = inst.arg1;
+                    if (!isConstant(inst.arg1)) users[inst.arg1].push_back(inst.result);
+                }
+            }
+            out.push_back(std::move(inst));
+        }
+        code = std::move(out);
+    }
+    
+    void eliminateDeadStores(std::vector<Instruction>& code) const {
+        // Variables are observable at the end and, since a failing division
+        // stops the program there, right before every division that may fail.
+        std::vector<Operand> variables;
+        if (options.variablesLiveOut) {
+            std::unordered_set<Operand, OperandHash> seen;
+            for (const Instruction& inst : code) {
+                if (inst.op != "print" && !isTemp(inst.result) && seen.insert(inst.result).second) {
+                    variables.push_back(inst.result);
+                }
+            }
+        }
+        std::unordered_set<Operand, OperandHash> live(variables.begin(), variables.end());
+        std::vector<bool> keep(code.size(), true);
+        for (size_t i = code.size(); i-- > 0;) {
+            const Instruction& inst = code[i];
+            if (inst.op != "print") {
+                bool fails = mayFail(inst);
+                if (!live.count(inst.result) && !fails) {
+                    keep[i] = false;
+                    continue;
+                }
+                live.erase(inst.result);
+                if (fails) live.insert(variables.begin(), variables.end());
+            }
+            if (!isConstant(inst.arg1)) live.insert(inst.arg1);
+            if (isArithmetic(inst) && !isConstant(inst.arg2)) live.insert(inst.arg2);
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (!keep[i]) continue;
+            if (n != i) code[n] = std::move(code[i]);
+            n++;
+        }
+        code.resize(n);
+    }
+    
+    void dump(const char* stage, const std::vector<Instruction>& code, const Interner& symbols) const {
+        if (!options.dumpIR) return;
+        *options.dumpStream << "== " << stage << " ==\n";
+        for (size_t i = 0; i < code.size(); i++) {
+            *options.dumpStream << "  " << i + 1 << ": " << code[i].toString(symbols) << "\n";
+        }
+    }
+    
+public:
+    OptimizerOptions options;
+    
+    bool enabled() const {
+        return options.enabled;
+    }
+    
+    // The symbols only name variables in the dumps.
+    void run(std::vector<Instruction>& code, const Interner& symbols) const {
+        dump("entrada", code, symbols);
+        if (options.constantFolding) {
+            foldConstants(code);
+            dump("constant-folding", code, symbols);
+        }
+        if (options.algebraic) {
+            simplifyAlgebra(code);
+            dump("algebraic", code, symbols);
+        }
+        if (options.cse) {
+            eliminateCommonSubexpressions(code);
+            dump("cse", code, symbols);
+        }
+        if (options.copyPropagation) {
+            propagateCopies(code);
+            dump("copy-propagation", code, symbols);
+        }
+        if (options.deadStores) {
+            eliminateDeadStores(code);
+            dump("dead-stores", code, symbols);
+        }
+    }
+};
+
+#endif
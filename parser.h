@@ -2,94 +2,257 @@
 #define PARSER_H
 
 #include "lexer.h"
-#include <memory>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
 
-class ASTNode {
-public:
-    virtual ~ASTNode() = default;
-    virtual void print(int indent = 0) const = 0;
-    virtual std::string getNodeType() const = 0;
+enum class NodeKind : uint8_t {
+    NUMBER, IDENTIFIER, BINARY_OP, ASSIGNMENT, PRINT
 };
 
-class NumberNode : public ASTNode {
-public:
+using NodeId = uint32_t;
+
+struct ASTNode {
+    NodeKind kind;
+    char op;
+    bool shared;
+    NodeId left, right;
+    SymbolId symbol;
     double value;
-    NumberNode(double val) : value(val) {}
-    void print(int indent = 0) const override {
-        std::cout << std::string(indent, ' ') << "Number: " << value << "\n";
-    }
-    std::string getNodeType() const override { return "Number"; }
+    SourceLocation location;
 };
 
-class IdentifierNode : public ASTNode {
-public:
-    std::string name;
-    IdentifierNode(const std::string& n) : name(n) {}
-    void print(int indent = 0) const override {
-        std::cout << std::string(indent, ' ') << "Identifier: " << name << "\n";
+class Ast {
+private:
+    struct Key {
+        NodeKind kind;
+        char op;
+        NodeId left, right;
+        SymbolId symbol;
+        uint64_t value;
+        
+        bool operator==(const Key& other) const {
+            return kind == other.kind && op == other.op && left == other.left && right == other.right &&
+                   symbol == other.symbol && value == other.value;
+        }
+    };
+    
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = static_cast<uint64_t>(key.kind) << 8 | static_cast<uint8_t>(key.op);
+            for (uint64_t part : {uint64_t(key.left), uint64_t(key.right), uint64_t(key.symbol), key.value}) {
+                h = (h ^ part) * 0x100000001b3ULL;
+                h ^= h >> 29;
+            }
+            return static_cast<size_t>(h);
+        }
+    };
+    
+    std::vector<ASTNode> nodes;
+    std::vector<NodeId> statements;
+    const Interner* symbols;
+    bool sharing = false;
+    std::unordered_map<Key, NodeId, KeyHash> consed;
+    
+    static Key keyOf(const ASTNode& node) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &node.value, sizeof(bits));
+        return {node.kind, node.op, node.left, node.right, node.symbol, bits};
     }
-    std::string getNodeType() const override { return "Identifier"; }
-};
-
-class BinaryOpNode : public ASTNode {
-public:
-    std::string op;
-    std::unique_ptr<ASTNode> left, right;
     
-    BinaryOpNode(const std::string& operation, std::unique_ptr<ASTNode> l, std::unique_ptr<ASTNode> r)
-        : op(operation), left(std::move(l)), right(std::move(r)) {}
+    NodeId add(const ASTNode& node) {
+        nodes.push_back(node);
+        return static_cast<NodeId>(nodes.size() - 1);
+    }
     
-    void print(int indent = 0) const override {
-        std::cout << std::string(indent, ' ') << "BinaryOp: " << op << "\n";
-        left->print(indent + 2);
-        right->print(indent + 2);
+    // With sharing on, an expression node equal to one built earlier in the
+    // chunk is not built again: the earlier node is returned and marked
+    // shared. Children are keyed by id, so forgetting a variable's
+    // identifier also retires every node built on top of it.
+    NodeId cons(const ASTNode& node) {
+        if (!sharing) return add(node);
+        auto [it, inserted] = consed.try_emplace(keyOf(node), static_cast<NodeId>(nodes.size()));
+        if (!inserted) {
+            nodes[it->second].shared = true;
+            return it->second;
+        }
+        return add(node);
     }
-    std::string getNodeType() const override { return "BinaryOp"; }
-};
-
-class AssignmentNode : public ASTNode {
+    
 public:
-    std::string variable;
-    std::unique_ptr<ASTNode> expression;
+    explicit Ast(const Interner* interner = nullptr) : symbols(interner) {}
     
-    AssignmentNode(const std::string& var, std::unique_ptr<ASTNode> expr)
-        : variable(var), expression(std::move(expr)) {}
+    void clear() {
+        nodes.clear();
+        statements.clear();
+        consed.clear();
+    }
     
-    void print(int indent = 0) const override {
-        std::cout << std::string(indent, ' ') << "Assignment: " << variable << "\n";
-        expression->print(indent + 2);
+    // Expressions may then reference nodes of earlier statements, which
+    // visitors see as child ids below the statement's first node.
+    void setSharing(bool enabled) {
+        sharing = enabled;
+        consed.clear();
+    }
+    
+    void reserve(size_t tokenCount) {
+        nodes.reserve(tokenCount);
+        statements.reserve(tokenCount / 4 + 1);
+    }
+    
+    NodeId number(double value, SourceLocation location = {}) {
+        return cons({NodeKind::NUMBER, 0, false, 0, 0, 0, value, location});
     }
-    std::string getNodeType() const override { return "Assignment"; }
-};
-
-class PrintNode : public ASTNode {
-public:
-    std::unique_ptr<ASTNode> expression;
-    PrintNode(std::unique_ptr<ASTNode> expr) : expression(std::move(expr)) {}
     
-    void print(int indent = 0) const override {
-        std::cout << std::string(indent, ' ') << "Print:\n";
-        expression->print(indent + 2);
+    NodeId identifier(SymbolId symbol, SourceLocation location = {}) {
+        return cons({NodeKind::IDENTIFIER, 0, false, 0, 0, symbol, 0, location});
+    }
+    
+    NodeId binaryOp(char op, NodeId left, NodeId right, SourceLocation location = {}) {
+        return cons({NodeKind::BINARY_OP, op, false, left, right, 0, 0, location});
+    }
+    
+    NodeId assignment(SymbolId variable, NodeId expression, NodeId first, SourceLocation location = {}) {
+        NodeId id = add({NodeKind::ASSIGNMENT, 0, false, expression, first, variable, 0, location});
+        statements.push_back(id);
+        if (sharing) consed.erase(keyOf({NodeKind::IDENTIFIER, 0, false, 0, 0, variable, 0, {}}));
+        return id;
+    }
+    
+    NodeId print(NodeId expression, NodeId first, SourceLocation location = {}) {
+        NodeId id = add({NodeKind::PRINT, 0, false, expression, first, 0, 0, location});
+        statements.push_back(id);
+        return id;
+    }
+    
+    NodeId nextId() const {
+        return static_cast<NodeId>(nodes.size());
+    }
+    
+    const ASTNode& node(NodeId id) const {
+        return nodes[id];
+    }
+    
+    std::string_view name(const ASTNode& node) const {
+        return symbols->name(node.symbol);
+    }
+    
+    const std::vector<NodeId>& getStatements() const {
+        return statements;
+    }
+    
+    size_t size() const {
+        return nodes.size();
+    }
+    
+    void print(NodeId root, int indent = 0) const {
+        std::vector<std::pair<NodeId, int>> pending{{root, indent}};
+        while (!pending.empty()) {
+            auto [id, depth] = pending.back();
+            pending.pop_back();
+            const ASTNode& n = nodes[id];
+            std::cout << std::string(depth, ' ');
+            switch (n.kind) {
+                case NodeKind::NUMBER:
+                    std::cout << "Number: " << n.value << "\n";
+                    break;
+                case NodeKind::IDENTIFIER:
+                    std::cout << "Identifier: " << name(n) << "\n";
+                    break;
+                case NodeKind::BINARY_OP:
+                    std::cout << "BinaryOp: " << n.op << "\n";
+                    pending.push_back({n.right, depth + 2});
+                    pending.push_back({n.left, depth + 2});
+                    break;
+                case NodeKind::ASSIGNMENT:
+                    std::cout << "Assignment: " << name(n) << "\n";
+                    pending.push_back({n.left, depth + 2});
+                    break;
+                case NodeKind::PRINT:
+                    std::cout << "Print:\n";
+                    pending.push_back({n.left, depth + 2});
+                    break;
+            }
+        }
     }
-    std::string getNodeType() const override { return "Print"; }
 };
 
-class Parser {
+// Expression nodes are stored in post-order and each statement records the
+// first node of its expression, so a walk is a linear scan over [first, root].
+// Shared nodes are only visited by the statement that built them; a root
+// below `first` means the whole expression was built before.
+template <typename Visitor>
+void walkExpression(const Ast& ast, NodeId first, NodeId root, Visitor& visitor) {
+    for (NodeId id = first; id <= root; id++) {
+        const ASTNode& n = ast.node(id);
+        switch (n.kind) {
+            case NodeKind::NUMBER: visitor.number(id, n); break;
+            case NodeKind::IDENTIFIER: visitor.identifier(id, n); break;
+            case NodeKind::BINARY_OP: visitor.binaryOp(id, n); break;
+            default: break;
+        }
+    }
+}
+
+template <typename Visitor>
+void walk(const Ast& ast, Visitor& visitor) {
+    for (NodeId id : ast.getStatements()) {
+        const ASTNode& n = ast.node(id);
+        visitor.beginStatement(n.right);
+        walkExpression(ast, n.right, n.left, visitor);
+        if (n.kind == NodeKind::ASSIGNMENT) visitor.assignment(id, n);
+        else visitor.print(id, n);
+    }
+}
+
+// The grammar is written once against a Builder: Ast records the tree for
+// the later passes, while Translator (translator.h) checks and emits each
+// construct as it is reduced. Both see the same calls in the same order.
+template <typename Builder>
+class BasicParser {
 private:
-    std::vector<Token> tokens;
+    std::string_view source;
+    Lexer* lexer;
+    std::vector<TokenView> tokens;
     size_t position;
+    Builder builder;
+    std::vector<std::pair<char, SourceLocation>> operators;
+    std::vector<NodeId> operands;
     
-    Token current() const {
-        return (position >= tokens.size()) ? tokens.back() : tokens[position];
+    const TokenView& at(size_t index) {
+        while (lexer && index >= tokens.size() &&
+               (tokens.empty() || tokens.back().type != TokenType::END_OF_FILE)) {
+            tokens.push_back(lexer->next());
+        }
+        return (index >= tokens.size()) ? tokens.back() : tokens[index];
     }
     
-    Token peek(int offset = 1) const {
-        return (position + offset >= tokens.size()) ? tokens.back() : tokens[position + offset];
+    const TokenView& current() {
+        return at(position);
+    }
+    
+    const TokenView& peek(int offset = 1) {
+        return at(position + offset);
+    }
+    
+    std::string_view text(const TokenView& tok) const {
+        return source.substr(tok.offset, tok.length);
+    }
+    
+    double literal(const TokenView& tok) const {
+        double value = 0;
+        std::errc error = readNumber(text(tok), value);
+        if (error != std::errc()) throw std::runtime_error(numberError(text(tok), error) + " en linea " + std::to_string(tok.line));
+        return value;
+    }
+    
+    static SourceLocation locate(const TokenView& tok) {
+        return {static_cast<uint32_t>(tok.line), static_cast<uint32_t>(tok.column)};
     }
     
     void advance() {
-        if (position < tokens.size() - 1) position++;
+        if (current().type != TokenType::END_OF_FILE) position++;
     }
     
     bool match(TokenType type) {
@@ -99,82 +262,144 @@ private:
     
     void expect(TokenType type, const std::string& message) {
         if (current().type != type) {
-            throw std::runtime_error("Error sintaxis: " + message + 
+            throw std::runtime_error("Error sintaxis: " + message +
                                    " linea " + std::to_string(current().line));
         }
         advance();
     }
     
-    std::unique_ptr<ASTNode> factor() {
-        Token tok = current();
-        if (tok.type == TokenType::NUMBER) {
-            advance();
-            return std::make_unique<NumberNode>(std::stod(tok.lexeme));
+    static int precedence(TokenType type) {
+        switch (type) {
+            case TokenType::PLUS:
+            case TokenType::MINUS: return 1;
+            case TokenType::MULTIPLY:
+            case TokenType::DIVIDE: return 2;
+            default: return 0;
         }
-        if (tok.type == TokenType::IDENTIFIER) {
-            advance();
-            return std::make_unique<IdentifierNode>(tok.lexeme);
-        }
-        if (match(TokenType::LPAREN)) {
-            auto expr = expression();
-            expect(TokenType::RPAREN, "esperaba ')'");
-            return expr;
-        }
-        throw std::runtime_error("Error sintaxis linea " + std::to_string(tok.line));
     }
     
-    std::unique_ptr<ASTNode> term() {
-        auto left = factor();
-        while (current().type == TokenType::MULTIPLY || current().type == TokenType::DIVIDE) {
-            Token op = current();
-            advance();
-            auto right = factor();
-            left = std::make_unique<BinaryOpNode>(op.lexeme, std::move(left), std::move(right));
-        }
-        return left;
+    static int precedence(char op) {
+        return (op == '*' || op == '/') ? 2 : 1;
     }
     
-    std::unique_ptr<ASTNode> expression() {
-        auto left = term();
-        while (current().type == TokenType::PLUS || current().type == TokenType::MINUS) {
-            Token op = current();
+    void reduce() {
+        auto [op, location] = operators.back();
+        operators.pop_back();
+        NodeId right = operands.back();
+        operands.pop_back();
+        operands.back() = builder.binaryOp(op, operands.back(), right, location);
+    }
+    
+    // Shunting-yard over the token stream: nesting depth lives in the
+    // operator stack instead of the call stack, and nodes come out in
+    // post-order exactly as the recursive grammar would build them.
+    NodeId expression() {
+        operators.clear();
+        operands.clear();
+        size_t depth = 0;
+        while (true) {
+            while (match(TokenType::LPAREN)) {
+                operators.push_back({'(', {}});
+                depth++;
+            }
+            const TokenView& tok = current();
+            if (tok.type == TokenType::NUMBER) operands.push_back(builder.number(literal(tok), locate(tok)));
+            else if (tok.type == TokenType::IDENTIFIER) operands.push_back(builder.identifier(tok.symbol, locate(tok)));
+            else throw std::runtime_error("Error sintaxis linea " + std::to_string(tok.line));
+            advance();
+            
+            while (depth > 0 && current().type == TokenType::RPAREN) {
+                while (operators.back().first != '(') reduce();
+                operators.pop_back();
+                depth--;
+                advance();
+            }
+            
+            int prec = precedence(current().type);
+            if (prec == 0) break;
+            while (!operators.empty() && operators.back().first != '(' && precedence(operators.back().first) >= prec) {
+                reduce();
+            }
+            operators.push_back({text(current())[0], locate(current())});
             advance();
-            auto right = term();
-            left = std::make_unique<BinaryOpNode>(op.lexeme, std::move(left), std::move(right));
         }
-        return left;
+        if (depth > 0) {
+            throw std::runtime_error("Error sintaxis: esperaba ')' linea " + std::to_string(current().line));
+        }
+        while (!operators.empty()) reduce();
+        return operands.back();
     }
     
-    std::unique_ptr<ASTNode> statement() {
+    void statement() {
         if (current().type == TokenType::PRINT) {
+            SourceLocation location = locate(current());
             advance();
             expect(TokenType::LPAREN, "esperaba '(' despues de print");
-            auto expr = expression();
+            NodeId first = builder.nextId();
+            NodeId expr = expression();
             expect(TokenType::RPAREN, "esperaba ')'");
             expect(TokenType::SEMICOLON, "esperaba ';'");
-            return std::make_unique<PrintNode>(std::move(expr));
+            builder.print(expr, first, location);
+            return;
         }
         if (current().type == TokenType::IDENTIFIER && peek().type == TokenType::ASSIGN) {
-            std::string varName = current().lexeme;
+            SymbolId variable = current().symbol;
+            SourceLocation location = locate(current());
             advance();
             advance();
-            auto expr = expression();
+            NodeId first = builder.nextId();
+            NodeId expr = expression();
             expect(TokenType::SEMICOLON, "esperaba ';'");
-            return std::make_unique<AssignmentNode>(varName, std::move(expr));
+            builder.assignment(variable, expr, first, location);
+            return;
         }
         throw std::runtime_error("Error sintaxis linea " + std::to_string(current().line));
     }
     
 public:
-    Parser(const std::vector<Token>& toks) : tokens(toks), position(0) {}
+    BasicParser(std::string_view src, std::vector<TokenView> toks, const Interner& symbols)
+        : source(src), lexer(nullptr), tokens(std::move(toks)), position(0), builder(&symbols) {}
+    
+    BasicParser(Lexer& lex)
+        : source(lex.getSource()), lexer(&lex), position(0), builder(&lex.getSymbols()) {}
     
-    std::vector<std::unique_ptr<ASTNode>> parse() {
-        std::vector<std::unique_ptr<ASTNode>> statements;
+    BasicParser(Lexer& lex, Builder target)
+        : source(lex.getSource()), lexer(&lex), position(0), builder(std::move(target)) {}
+    
+    // Hash-conses expressions: a subexpression repeated within a chunk, with
+    // no assignment to its variables in between, becomes one node.
+    void shareExpressions(bool enabled) {
+        builder.setSharing(enabled);
+    }
+    
+    bool done() {
+        return current().type == TokenType::END_OF_FILE;
+    }
+    
+    // Streaming mode: pulls tokens from the Lexer on demand and keeps only
+    // the ones belonging to the statement being parsed.
+    Builder& parseChunk(size_t maxStatements) {
+        builder.clear();
+        for (size_t n = 0; n < maxStatements && !done(); n++) {
+            statement();
+            if (lexer) {
+                tokens.erase(tokens.begin(), tokens.begin() + std::min(position, tokens.size()));
+                position = 0;
+            }
+        }
+        return builder;
+    }
+    
+    Builder parse() {
+        builder.clear();
+        builder.reserve(tokens.size());
         while (current().type != TokenType::END_OF_FILE) {
-            statements.push_back(statement());
+            statement();
         }
-        return statements;
+        return std::move(builder);
     }
 };
 
-#endif
\ No newline at end of file
+using Parser = BasicParser<Ast>;
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "vm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <unordered_map>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+#endif
+
+// Runs bytecode one instruction at a time, timing each one, and adds the
+// cost to the source location it was generated from. Sites are keyed by
+// line, column and opcode, so chunks flushed by the batch driver still
+// accumulate and the LOADs that feed an instruction, which share its
+// location, are counted apart from it.
+class Profiler {
+private:
+    struct Site {
+        SourceLocation location;
+        OpCode op;
+        uint64_t count = 0;
+        uint64_t cycles = 0;
+    };
+    
+    struct SiteKey {
+        uint64_t position;
+        OpCode op;
+        
+        bool operator==(const SiteKey& other) const {
+            return position == other.position && op == other.op;
+        }
+    };
+    
+    struct SiteHash {
+        size_t operator()(const SiteKey& key) const {
+            return std::hash<uint64_t>()(key.position * 8 + static_cast<uint64_t>(key.op));
+        }
+    };
+    
+    std::unordered_map<SiteKey, Site, SiteHash> sites;
+    uint64_t overhead;
+    uint32_t lineOffset;
+    
+    static uint64_t now() {
+#if defined(__x86_64__) && defined(__GNUC__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+    
+    static const char* opName(OpCode op) {
+        switch (op) {
+            case OpCode::MOVE: return "=";
+            case OpCode::ADD: return "+";
+            case OpCode::SUB: return "-";
+            case OpCode::MUL: return "*";
+            case OpCode::DIV: return "/";
+            case OpCode::PRINT: return "print";
+            case OpCode::LOAD: return "load";
+        }
+        return "?";
+    }
+    
+    void merge(const Program& program, size_t from, size_t to, const std::vector<uint64_t>& spent) {
+        for (size_t i = from; i < to; i++) {
+            SourceLocation location = program.locations[i];
+            location.line += lineOffset;
+            OpCode op = program.code[i].op;
+            Site& site = sites[{static_cast<uint64_t>(location.line) << 32 | location.column, op}];
+            site.location = location;
+            site.op = op;
+            site.count++;
+            site.cycles += spent[i - from] > overhead ? spent[i - from] - overhead : 0;
+        }
+    }
+    
+    std::vector<const Site*> sorted() const {
+        std::vector<const Site*> order;
+        order.reserve(sites.size());
+        for (const auto& entry : sites) order.push_back(&entry.second);
+        std::sort(order.begin(), order.end(), [](const Site* a, const Site* b) {
+            if (a->cycles != b->cycles) return a->cycles > b->cycles;
+            if (a->location.line != b->location.line) return a->location.line < b->location.line;
+            if (a->location.column != b->location.column) return a->location.column < b->location.column;
+            return a->op < b->op;
+        });
+        return order;
+    }
+    
+public:
+    Profiler() : overhead(UINT64_MAX), lineOffset(0) {
+        for (int i = 0; i < 1000; i++) {
+            uint64_t start = now();
+            overhead = std::min(overhead, now() - start);
+        }
+    }
+    
+    // Added to every line recorded from now on; the REPL uses it to number
+    // sites by input line, since each line is lexed on its own.
+    void setLineOffset(uint32_t offset) {
+        lineOffset = offset;
+    }
+    
+    size_t run(VM& vm, const Program& program, size_t from = 0) {
+        double* m = vm.prepare(program);
+        size_t end = program.code.size();
+        std::vector<uint64_t> spent(end - from);
+        size_t i = from;
+        try {
+            for (; i < end; i++) {
+                uint64_t start = now();
+                vm.step(m, &program.code[i]);
+                spent[i - from] = now() - start;
+            }
+        } catch (...) {
+            merge(program, from, i, spent);
+            throw;
+        }
+        merge(program, from, end, spent);
+        return end - from;
+    }
+    
+    void report(std::ostream& out, size_t top = 10) const {
+        uint64_t count = 0, cycles = 0;
+        std::unordered_map<uint32_t, Site> lines;
+        for (const auto& entry : sites) {
+            const Site& site = entry.second;
+            count += site.count;
+            cycles += site.cycles;
+            Site& line = lines[site.location.line];
+            line.location.line = site.location.line;
+            line.count += site.count;
+            line.cycles += site.cycles;
+        }
+        auto percent = [&](uint64_t part) { return cycles ? 100.0 * part / cycles : 0.0; };
+        char buffer[160];
+        out << "  instrucciones ejecutadas: " << count << ", ciclos: " << cycles << "\n\n";
+        
+        std::vector<const Site*> hotLines;
+        for (const auto& entry : lines) hotLines.push_back(&entry.second);
+        std::sort(hotLines.begin(), hotLines.end(), [](const Site* a, const Site* b) {
+            return a->cycles != b->cycles ? a->cycles > b->cycles : a->location.line < b->location.line;
+        });
+        out << "  Lineas mas costosas:\n";
+        std::snprintf(buffer, sizeof(buffer), "    %-12s %14s %16s %8s\n", "linea", "ejecuciones", "ciclos", "%");
+        out << buffer;
+        for (size_t i = 0; i < hotLines.size() && i < top; i++) {
+            const Site* line = hotLines[i];
+            std::snprintf(buffer, sizeof(buffer), "    %-12u %14llu %16llu %8.2f\n", line->location.line,
+                          static_cast<unsigned long long>(line->count), static_cast<unsigned long long>(line->cycles),
+                          percent(line->cycles));
+            out << buffer;
+        }
+        
+        std::vector<const Site*> hotSites = sorted();
+        out << "\n  Instrucciones mas costosas:\n";
+        std::snprintf(buffer, sizeof(buffer), "    %-12s %-6s %14s %16s %8s\n", "posicion", "op", "ejecuciones", "ciclos", "%");
+        out << buffer;
+        for (size_t i = 0; i < hotSites.size() && i < top; i++) {
+            const Site* site = hotSites[i];
+            std::string position = std::to_string(site->location.line) + ":" + std::to_string(site->location.column);
+            std::snprintf(buffer, sizeof(buffer), "    %-12s %-6s %14llu %16llu %8.2f\n", position.c_str(), opName(site->op),
+                          static_cast<unsigned long long>(site->count), static_cast<unsigned long long>(site->cycles),
+                          percent(site->cycles));
+            out << buffer;
+        }
+    }
+    
+    // One "root;linea N;N:C op cycles" line per site, the folded-stack
+    // format read by flamegraph.pl and speedscope.
+    void writeFolded(std::ostream& out, const std::string& root) const {
+        for (const Site* site : sorted()) {
+            out << root << ";linea " << site->location.line << ";" << site->location.line << ":"
+                << site->location.column << " " << opName(site->op) << " " << site->cycles << "\n";
+        }
+    }
+};
+
+#endif
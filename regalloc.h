@@ -0,0 +1,136 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ir.h"
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <vector>
+
+// Linear scan over the live intervals of the temporaries in a chunk of IR.
+// Temps are renamed onto reusable locations, so the number of distinct temps
+// grows with expression depth instead of program length. With a fixed
+// register file of N entries, temps become %r0..%rN-1 and the intervals that
+// do not fit are spilled to %sK.
+class RegisterAllocator {
+private:
+    struct Interval {
+        size_t start, end;
+        bool spilled;
+        uint32_t location;
+    };
+    
+    // A location freed at instruction i can only hold intervals starting at
+    // or after i. Spilled victims start before the current instruction, so
+    // not every free location suits them.
+    struct Pool {
+        std::set<uint32_t> free;
+        std::vector<size_t> released;
+        uint32_t count = 0;
+        
+        uint32_t take(size_t from) {
+            for (auto it = free.begin(); it != free.end(); ++it) {
+                if (released[*it] <= from) {
+                    uint32_t location = *it;
+                    free.erase(it);
+                    return location;
+                }
+            }
+            released.push_back(0);
+            return count++;
+        }
+        
+        void give(uint32_t location, size_t at) {
+            released[location] = at;
+            free.insert(location);
+        }
+    };
+    
+    uint32_t registerFile;
+    uint32_t peak;
+    
+    static bool usesArg2(const Instruction& inst) {
+        return inst.op != "=" && inst.op != "print";
+    }
+    
+    template <typename Visitor>
+    static void forEachTemp(std::vector<Instruction>& code, size_t from, Visitor&& visit) {
+        std::vector<uint32_t> current;
+        uint32_t defined = 0;
+        for (size_t i = from; i < code.size(); i++) {
+            Instruction& inst = code[i];
+            if (isTemp(inst.arg1)) visit(i, current.at(inst.arg1.index), inst.arg1);
+            if (usesArg2(inst) && isTemp(inst.arg2)) visit(i, current.at(inst.arg2.index), inst.arg2);
+            if (inst.op != "print" && isTemp(inst.result)) {
+                if (inst.result.index >= current.size()) current.resize(inst.result.index + 1);
+                current[inst.result.index] = defined;
+                visit(i, defined++, inst.result);
+            }
+        }
+    }
+    
+    static void expire(std::set<std::pair<size_t, uint32_t>>& active, size_t at, std::vector<Interval>& intervals, Pool& pool) {
+        while (!active.empty() && active.begin()->first <= at) {
+            pool.give(intervals[active.begin()->second].location, active.begin()->first);
+            active.erase(active.begin());
+        }
+    }
+    
+public:
+    explicit RegisterAllocator(uint32_t file = 0) : registerFile(file), peak(0) {}
+    
+    uint32_t fileSize() const {
+        return registerFile;
+    }
+    
+    // Largest number of registers (not counting spill slots) used by the
+    // last call to run.
+    uint32_t registersUsed() const {
+        return peak;
+    }
+    
+    void run(std::vector<Instruction>& code, size_t from = 0) {
+        std::vector<Interval> intervals;
+        forEachTemp(code, from, [&](size_t i, uint32_t id, const Operand&) {
+            if (id == intervals.size()) intervals.push_back({i, i, false, 0});
+            else intervals[id].end = i;
+        });
+        
+        Pool registers, spills;
+        std::set<std::pair<size_t, uint32_t>> active, spilled;
+        for (uint32_t id = 0; id < intervals.size(); id++) {
+            Interval& current = intervals[id];
+            expire(active, current.start, intervals, registers);
+            expire(spilled, current.start, intervals, spills);
+            if (registerFile == 0 || registers.count < registerFile || !registers.free.empty()) {
+                current.location = registers.take(current.start);
+                active.insert({current.end, id});
+                continue;
+            }
+            auto last = std::prev(active.end());
+            if (last->first > current.end) {
+                Interval& victim = intervals[last->second];
+                current.location = victim.location;
+                victim.spilled = true;
+                victim.location = spills.take(victim.start);
+                spilled.insert(*last);
+                active.erase(last);
+                active.insert({current.end, id});
+            } else {
+                current.spilled = true;
+                current.location = spills.take(current.start);
+                spilled.insert({current.end, id});
+            }
+        }
+        peak = registers.count;
+        
+        OperandKind kept = registerFile == 0 ? OperandKind::TEMP : OperandKind::REGISTER;
+        forEachTemp(code, from, [&](size_t, uint32_t id, Operand& operand) {
+            const Interval& interval = intervals[id];
+            operand.kind = interval.spilled ? OperandKind::SPILL : kept;
+            operand.index = interval.location;
+        });
+    }
+};
+
+#endif
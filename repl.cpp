@@ -1,133 +1,204 @@
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <new>
 #include <string>
-#include "lexer.h"
-#include "parser.h"
-#include "semantic.h"
-#include "codegen.h"
+#include "repl.h"
+#include "driver.h"
+#include "build.h"
+#include "csv.h"
+#include "server.h"
+#include <csignal>
 
-class REPL {
-private:
-    SemanticAnalyzer semantic;
-    CodeGenerator codegen;
-    std::vector<std::unique_ptr<ASTNode>> allStatements;
-    
-    void printBanner() {
-        std::cout << "\n╔════════════════════════════════════════╗\n";
-        std::cout << "║   MINI COMPILADOR INTERACTIVO (REPL)   ║\n";
-        std::cout << "╚════════════════════════════════════════╝\n\n";
-        std::cout << "Comandos especiales:\n";
-        std::cout << "  :help    - Ayuda\n";
-        std::cout << "  :vars    - Ver variables\n";
-        std::cout << "  :clear   - Limpiar variables\n";
-        std::cout << "  :exit    - Salir\n\n";
-        std::cout << "Ejemplos:\n";
-        std::cout << "  x = 5 + 3;\n";
-        std::cout << "  print(x);\n\n";
+void* operator new(size_t size) {
+    allocatedBytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+// Out of line, or GCC sees free() applied to what the replaced operator new
+// returned and warns with -Wmismatched-new-delete.
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+struct BatchOptions {
+    std::string cache;
+    std::string stats;
+    std::string profile;
+    bool share = false;
+    bool fused = false;
+    bool jit = false;
+    uint32_t registers = 0;
+};
+
+void writeStats(const Stats& stats, const std::string& path) {
+    if (path == "-") {
+        stats.writeJson(std::cerr);
+        return;
     }
-    
-    void printHelp() {
-        std::cout << "\n=== SINTAXIS ===\n\n";
-        std::cout << "Asignacion: variable = expresion;\n";
-        std::cout << "Print:      print(expresion);\n";
-        std::cout << "Operadores: + - * /\n";
-        std::cout << "Ejemplos:\n";
-        std::cout << "  x = 10;\n";
-        std::cout << "  y = x * 2 + 5;\n";
-        std::cout << "  print(y);\n\n";
+    std::ofstream out(path);
+    stats.writeJson(out);
+    if (!out) std::cerr << "Aviso: no se pudieron escribir las estadisticas en '" << path << "'\n";
+}
+
+void writeProfile(const Profiler& profiler, const std::string& script, const std::string& path) {
+    std::cerr << "=== PERFIL ===\n";
+    profiler.report(std::cerr);
+    std::ofstream out(path);
+    profiler.writeFolded(out, script);
+    if (!out) std::cerr << "Aviso: no se pudo escribir el perfil en '" << path << "'\n";
+}
+
+int runBatch(const std::string& command, const std::string& path, const BatchOptions& options) {
+    std::ios::sync_with_stdio(false);
+    BatchDriver driver;
+    int status = 0;
+    try {
+        if (!options.cache.empty()) driver.setCache(options.cache);
+        if (!options.profile.empty()) driver.enableProfiler();
+        driver.shareExpressions(options.share);
+        driver.setFused(options.fused);
+        driver.setJit(options.jit);
+        driver.setRegisterFile(options.registers);
+        driver.processFile(path, command == "run" ? BatchMode::RUN : BatchMode::COMPILE);
+        driver.flushOutput();
+    } catch (const std::exception& e) {
+        driver.flushOutput();
+        std::cout.flush();
+        std::cerr << e.what() << "\n";
+        status = 1;
     }
-    
-    void showVariables() {
-        std::cout << "\n=== VARIABLES ===\n";
-        const auto& symbols = semantic.getSymbolTable().getSymbols();
-        if (symbols.empty()) {
-            std::cout << "  (ninguna)\n";
-        } else {
-            for (const auto& entry : symbols) {
-                std::cout << "  " << entry.first << " : " << entry.second << "\n";
-            }
-        }
-        std::cout << "\n";
+    if (!options.stats.empty()) writeStats(driver.getStats(), options.stats);
+    if (!options.profile.empty()) writeProfile(*driver.getProfiler(), path, options.profile);
+    return status;
+}
+
+// Diagnostics come out sorted by path, whatever order the workers
+// finished in.
+int runBuild(std::vector<std::string> args) {
+    unsigned threads = 0;
+    if (args.size() >= 3 && args[1] == "-j") {
+        threads = static_cast<unsigned>(std::strtoul(args[2].c_str(), nullptr, 10));
+        args.erase(args.begin() + 1, args.begin() + 3);
     }
-    
-    void clearVariables() {
-        semantic = SemanticAnalyzer();
-        codegen = CodeGenerator();
-        allStatements.clear();
-        std::cout << "\nVariables limpiadas\n\n";
+    if (args.size() < 3) {
+        std::cerr << "Uso: build [-j hilos] directorio archivo.mc...\n";
+        return 2;
     }
-    
-    bool processCommand(const std::string& input) {
-        std::string cmd = input;
-        size_t start = cmd.find_first_not_of(" \t\n\r");
-        if (start == std::string::npos) return true;
-        cmd = cmd.substr(start);
-        cmd = cmd.substr(0, cmd.find_last_not_of(" \t\n\r") + 1);
-        
-        if (cmd.empty()) return true;
-        if (cmd == ":help" || cmd == ":h") { printHelp(); return true; }
-        if (cmd == ":vars" || cmd == ":v") { showVariables(); return true; }
-        if (cmd == ":clear" || cmd == ":c") { clearVariables(); return true; }
-        if (cmd == ":exit" || cmd == ":quit" || cmd == ":q") return false;
-        return true;
+    std::vector<std::string> paths(args.begin() + 2, args.end());
+    BuildReport report = ParallelBuilder(args[1], threads).build(paths);
+    for (const BuildDiagnostic& diagnostic : report.diagnostics) {
+        std::cerr << diagnostic.path << ": " << diagnostic.message << "\n";
     }
-    
-    void evaluateLine(const std::string& line) {
-        try {
-            if (!line.empty() && line[0] == ':') {
-                if (!processCommand(line)) {
-                    std::cout << "\nAdios!\n\n";
-                    exit(0);
-                }
-                return;
-            }
-            
-            std::string trimmed = line;
-            size_t start = trimmed.find_first_not_of(" \t\n\r");
-            if (start == std::string::npos) return;
-            trimmed = trimmed.substr(start);
-            trimmed = trimmed.substr(0, trimmed.find_last_not_of(" \t\n\r") + 1);
-            
-            if (trimmed.empty()) return;
-            if (trimmed.back() != ';') {
-                std::cerr << "Error: falta ';' al final\n";
-                return;
-            }
-            
-            Lexer lexer(line);
-            std::vector<Token> tokens = lexer.tokenize();
-            Parser parser(tokens);
-            std::vector<std::unique_ptr<ASTNode>> statements = parser.parse();
-            semantic.analyze(statements);
-            
-            for (auto& stmt : statements) {
-                allStatements.push_back(std::move(stmt));
-            }
-            
-            codegen.generate(allStatements);
-            codegen.execute();
-            
-        } catch (const std::exception& e) {
-            std::cerr << e.what() << "\n";
-        }
+    std::cerr << report.compiled << " compilados, " << report.upToDate << " al dia, "
+              << report.diagnostics.size() << " con errores\n";
+    return report.diagnostics.empty() ? 0 : 1;
+}
+
+int runCsv(const std::vector<std::string>& args) {
+    std::ios::sync_with_stdio(false);
+    unsigned threads = args.size() == 5 ? static_cast<unsigned>(std::strtoul(args[4].c_str(), nullptr, 10)) : 0;
+    try {
+        MappedFile script(args[1]);
+        CsvEvaluator(threads).runToFile(script.view(), args[2], args[3]);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Serves until SIGINT or SIGTERM. The signals are blocked before the
+// workers start so that only this thread receives them.
+int runServer(const std::vector<std::string>& args) {
+    unsigned threads = args.size() == 3 ? static_cast<unsigned>(std::strtoul(args[2].c_str(), nullptr, 10)) : 0;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    Server server(args[1]);
+    try {
+        server.start(threads);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
     }
-    
-public:
-    void run() {
-        printBanner();
-        std::string line;
-        while (true) {
-            std::cout << ">>> ";
-            if (!std::getline(std::cin, line)) {
-                std::cout << "\n\nAdios!\n\n";
-                break;
+    std::cerr << "Escuchando en " << args[1] << " con " << threads << " hilos\n";
+    int received = 0;
+    sigwait(&signals, &received);
+    server.stop();
+    return 0;
+}
+
+int usage(const char* program) {
+    std::cerr << "Uso: " << program << " [--share] [--fused] [--jit] [--regs N] [--cache dir] [--stats archivo.json|-] [--profile archivo.folded] run|compile archivo.mc\n"
+              << "       " << program << " csv script.mc datos.csv salida.csv [hilos]\n"
+              << "       " << program << " build [-j hilos] directorio archivo.mc...\n"
+              << "       " << program << " serve socket [hilos]\n"
+              << "       " << program << " [--load sesion.snap]\n";
+    return 2;
+}
+
+// Options come before the mode, in any order; they are consumed from `args`.
+bool parseOptions(std::vector<std::string>& args, BatchOptions& options, std::string& snapshot) {
+    size_t i = 0;
+    for (; i < args.size() && args[i].compare(0, 2, "--") == 0; i++) {
+        const std::string& flag = args[i];
+        if (flag == "--share") {
+            options.share = true;
+        } else if (flag == "--fused") {
+            options.fused = true;
+        } else if (flag == "--jit") {
+            options.jit = true;
+        } else if (flag == "--cache" || flag == "--stats" || flag == "--profile" || flag == "--load" || flag == "--regs") {
+            if (i + 1 == args.size()) {
+                std::cerr << "Error: falta el valor de " << flag << "\n";
+                return false;
             }
-            evaluateLine(line);
+            const std::string& value = args[++i];
+            if (flag == "--regs") {
+                unsigned long size = std::strtoul(value.c_str(), nullptr, 10);
+                if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || size > 1024) {
+                    std::cerr << "Error: --regs espera un numero entre 0 y 1024\n";
+                    return false;
+                }
+                options.registers = static_cast<uint32_t>(size);
+                continue;
+            }
+            (flag == "--cache" ? options.cache : flag == "--stats" ? options.stats :
+             flag == "--profile" ? options.profile : snapshot) = value;
+        } else {
+            std::cerr << "Error: opcion desconocida '" << flag << "'\n";
+            return false;
         }
     }
-};
+    args.erase(args.begin(), args.begin() + static_cast<std::ptrdiff_t>(i));
+    return true;
+}
 
-int main() {
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    BatchOptions options;
+    std::string snapshot;
+    if (!parseOptions(args, options, snapshot)) return usage(argv[0]);
+    if (!snapshot.empty() && !args.empty()) return usage(argv[0]);
+    if (args.size() == 2 && (args[0] == "run" || args[0] == "compile")) {
+        return runBatch(args[0], args[1], options);
+    }
+    if ((args.size() == 4 || args.size() == 5) && args[0] == "csv") {
+        return runCsv(args);
+    }
+    if (!args.empty() && args[0] == "build") {
+        return runBuild(args);
+    }
+    if ((args.size() == 2 || args.size() == 3) && args[0] == "serve") {
+        return runServer(args);
+    }
+    if (!args.empty()) return usage(argv[0]);
     REPL repl;
+    if (!snapshot.empty()) repl.evaluateLine(":load " + snapshot);
     repl.run();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,308 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include <iostream>
+#include <string>
+#include <charconv>
+#include <fstream>
+#include <memory>
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "stats.h"
+#include "snapshot.h"
+
+class REPL {
+private:
+    std::ostream& out;
+    std::ostream& err;
+    std::string foldedPath = "perfil.folded";
+    bool fileCommands = true;
+    Interner symbols;
+    SemanticAnalyzer semantic;
+    CodeGenerator codegen;
+    VM vm;
+    // The file the session was last restored from, which still holds the
+    // code it ran before that.
+    std::unique_ptr<Snapshot> restored;
+    Stats stats;
+    std::unique_ptr<Profiler> profiler;
+    uint32_t lineNumber = 0;
+    
+    void printBanner() {
+        out << "\n╔════════════════════════════════════════╗\n";
+        out << "║   MINI COMPILADOR INTERACTIVO (REPL)   ║\n";
+        out << "╚════════════════════════════════════════╝\n\n";
+        out << "Comandos especiales:\n";
+        out << "  :help    - Ayuda\n";
+        out << "  :vars    - Ver variables\n";
+        out << "  :stats   - Ver contadores y tiempos por fase\n";
+        out << "  :profile - Perfilar la ejecucion por linea de entrada\n";
+        out << "  :clear   - Limpiar variables\n";
+        out << "  :opt     - Activar/desactivar optimizaciones\n";
+        out << "  :ir      - Mostrar el IR en cada pase\n";
+        out << "  :jit     - Ejecutar con codigo nativo x86-64\n";
+        out << "  :regs N  - Asignar temporales a N registros (0 = sin limite)\n";
+        out << "  :save F  - Guardar la sesion en el archivo F\n";
+        out << "  :load F  - Restaurar la sesion guardada en F\n";
+        out << "  :exit    - Salir\n\n";
+        out << "Ejemplos:\n";
+        out << "  x = 5 + 3;\n";
+        out << "  print(x);\n\n";
+    }
+    
+    void printHelp() {
+        out << "\n=== SINTAXIS ===\n\n";
+        out << "Asignacion: variable = expresion;\n";
+        out << "Print:      print(expresion);\n";
+        out << "Operadores: + - * /\n";
+        out << "Ejemplos:\n";
+        out << "  x = 10;\n";
+        out << "  y = x * 2 + 5;\n";
+        out << "  print(y);\n\n";
+    }
+    
+    void showVariables() {
+        out << "\n=== VARIABLES ===\n";
+        const SymbolTable& table = semantic.getSymbolTable();
+        if (table.size() == 0) {
+            out << "  (ninguna)\n";
+        } else {
+            table.print(out);
+        }
+        out << "\n";
+    }
+    
+    void showStats() {
+        out << "\n=== ESTADISTICAS ===\n";
+        stats.print(out);
+        out << "\n";
+    }
+    
+    void toggleProfiler() {
+        if (!profiler) {
+            profiler = std::make_unique<Profiler>();
+            out << "\nPerfilado activado\n\n";
+            return;
+        }
+        out << "\n=== PERFIL ===\n";
+        profiler->report(out);
+        if (!foldedPath.empty()) {
+            std::ofstream folded(foldedPath);
+            profiler->writeFolded(folded, "repl");
+            if (folded) out << "\n  Pilas agregadas escritas en " << foldedPath << "\n";
+        }
+        out << "\nPerfilado desactivado\n\n";
+        profiler.reset();
+    }
+    
+    void clearVariables() {
+        OptimizerOptions options = codegen.optimizerOptions();
+        bool jit = codegen.jit();
+        uint32_t registerFile = codegen.registerFile();
+        symbols = Interner();
+        semantic = SemanticAnalyzer(symbols);
+        codegen = CodeGenerator(symbols);
+        vm = VM();
+        restored.reset();
+        vm.setPrinter(printToStream, &out);
+        codegen.optimizerOptions() = options;
+        codegen.setJit(jit);
+        codegen.setRegisterFile(registerFile);
+        out << "\nVariables limpiadas\n\n";
+    }
+    
+    void toggleOptimizer() {
+        bool& enabled = codegen.optimizerOptions().enabled;
+        enabled = !enabled;
+        out << "\nOptimizaciones " << (enabled ? "activadas" : "desactivadas") << "\n\n";
+    }
+    
+    void toggleIRDump() {
+        bool& dump = codegen.optimizerOptions().dumpIR;
+        dump = !dump;
+        out << "\nVolcado de IR " << (dump ? "activado" : "desactivado") << "\n\n";
+    }
+    
+    void toggleJit() {
+        codegen.setJit(!codegen.jit());
+        out << "\nJIT " << (codegen.jit() ? "activado" : "desactivado") << "\n\n";
+    }
+    
+    void setRegisterFile(std::string argument) {
+        argument.erase(0, argument.find_first_not_of(" \t"));
+        size_t value = 0;
+        auto result = std::from_chars(argument.data(), argument.data() + argument.size(), value);
+        if (argument.empty() || result.ec != std::errc() || result.ptr != argument.data() + argument.size() || value > 1024) {
+            err << "Uso: :regs N (0-1024)\n";
+            return;
+        }
+        codegen.setRegisterFile(static_cast<uint32_t>(value));
+        if (value == 0) out << "\nTemporales reutilizados sin limite de registros\n\n";
+        else out << "\nTemporales asignados a " << value << " registros\n\n";
+    }
+    
+    static std::string argumentOf(const std::string& command) {
+        size_t start = command.find_first_not_of(" \t", command.find_first_of(" \t"));
+        return start == std::string::npos ? "" : command.substr(start);
+    }
+    
+    void saveSession(const std::string& path) {
+        if (path.empty()) {
+            err << "Uso: :save archivo\n";
+            return;
+        }
+        Snapshot::save(path, symbols, semantic, codegen, vm, lineNumber, restored.get());
+        out << "\nSesion guardada en " << path << "\n\n";
+    }
+    
+    bool processCommand(const std::string& input) {
+        std::string cmd = input;
+        size_t start = cmd.find_first_not_of(" \t\n\r");
+        if (start == std::string::npos) return true;
+        cmd = cmd.substr(start);
+        cmd = cmd.substr(0, cmd.find_last_not_of(" \t\n\r") + 1);
+        
+        if (cmd.empty()) return true;
+        if (cmd == ":help" || cmd == ":h") { printHelp(); return true; }
+        if (cmd == ":vars" || cmd == ":v") { showVariables(); return true; }
+        if (cmd == ":stats") { showStats(); return true; }
+        if (cmd == ":profile") { toggleProfiler(); return true; }
+        if (cmd == ":clear" || cmd == ":c") { clearVariables(); return true; }
+        if (cmd == ":opt") { toggleOptimizer(); return true; }
+        if (cmd == ":ir") { toggleIRDump(); return true; }
+        if (cmd == ":jit") { toggleJit(); return true; }
+        if (cmd.compare(0, 5, ":regs") == 0) { setRegisterFile(cmd.substr(5)); return true; }
+        if (cmd.compare(0, 5, ":save") == 0 || cmd.compare(0, 5, ":load") == 0) {
+            if (!fileCommands) err << "Error: " << cmd.substr(0, 5) << " no esta disponible en esta sesion\n";
+            else if (cmd[1] == 's') saveSession(argumentOf(cmd));
+            else loadSession(argumentOf(cmd));
+            return true;
+        }
+        if (cmd == ":exit" || cmd == ":quit" || cmd == ":q") return false;
+        return true;
+    }
+    
+    // A line that fails is undone as a whole: every variable it assigned gets
+    // back the value it had before the line, and the ones it would have
+    // defined are undefined again, even if their assignments already ran.
+    void rollback(const std::vector<SymbolId>& fresh, const std::vector<std::pair<SymbolId, double>>& saved) {
+        for (const auto& [id, value] : saved) vm.set(static_cast<Slot>(id), value);
+        for (SymbolId id : fresh) {
+            semantic.undefine(id);
+            vm.set(static_cast<Slot>(id), 0.0);
+        }
+    }
+    
+public:
+    // Returns false once the line asks to leave the session.
+    bool evaluateLine(const std::string& line) {
+        std::vector<SymbolId> fresh;
+        std::vector<std::pair<SymbolId, double>> saved;
+        try {
+            if (!line.empty() && line[0] == ':') return processCommand(line);
+            
+            std::string trimmed = line;
+            size_t start = trimmed.find_first_not_of(" \t\n\r");
+            if (start == std::string::npos) return true;
+            trimmed = trimmed.substr(start);
+            trimmed = trimmed.substr(0, trimmed.find_last_not_of(" \t\n\r") + 1);
+            
+            if (trimmed.empty()) return true;
+            if (trimmed.back() != ';') {
+                err << "Error: falta ';' al final\n";
+                return true;
+            }
+            
+            lineNumber++;
+            std::vector<TokenView> tokens;
+            {
+                Stats::Scope scope = stats.measure(Phase::LEXER);
+                Lexer lexer(line, symbols);
+                tokens = lexer.scan();
+            }
+            stats.count(Phase::LEXER, tokens.size());
+            Ast statements(&symbols);
+            {
+                Stats::Scope scope = stats.measure(Phase::PARSER);
+                Parser parser(line, std::move(tokens), symbols);
+                statements = parser.parse();
+            }
+            stats.count(Phase::PARSER, statements.size());
+            for (NodeId id : statements.getStatements()) {
+                const ASTNode& node = statements.node(id);
+                if (node.kind != NodeKind::ASSIGNMENT) continue;
+                if (!semantic.getSymbolTable().isDefined(node.symbol)) fresh.push_back(node.symbol);
+                else saved.emplace_back(node.symbol, vm.get(static_cast<Slot>(node.symbol)));
+            }
+            size_t defined = semantic.getSymbolTable().size();
+            {
+                Stats::Scope scope = stats.measure(Phase::SEMANTIC);
+                semantic.analyze(statements);
+            }
+            stats.count(Phase::SEMANTIC, semantic.getSymbolTable().size() - defined);
+            size_t emitted = codegen.getInstructions().size();
+            {
+                Stats::Scope scope = stats.measure(Phase::CODEGEN);
+                codegen.append(statements);
+            }
+            stats.count(Phase::CODEGEN, codegen.getInstructions().size() - emitted);
+            Stats::Scope scope = stats.measure(Phase::EXECUTE);
+            if (profiler) profiler->setLineOffset(lineNumber - 1);
+            stats.count(Phase::EXECUTE, codegen.executePending(vm, profiler.get()));
+            
+        } catch (const std::exception& e) {
+            rollback(fresh, saved);
+            err << e.what() << "\n";
+        }
+        return true;
+    }
+    
+    // Program output and command replies go to `output`, diagnostics to
+    // `errors`; a server session points both at its client.
+    explicit REPL(std::ostream& output = std::cout, std::ostream& errors = std::cerr)
+        : out(output), err(errors), semantic(symbols), codegen(symbols) {
+        vm.setPrinter(printToStream, &out);
+        codegen.optimizerOptions().dumpStream = &err;
+    }
+    
+    // Replaces the session with one saved by :save, without replaying it.
+    void loadSession(const std::string& path) {
+        if (path.empty()) {
+            err << "Uso: :load archivo\n";
+            return;
+        }
+        restored = Snapshot::load(path, symbols, semantic, codegen, vm, lineNumber);
+        out << "\nSesion restaurada de " << path << " (" << semantic.getSymbolTable().size() << " variables)\n\n";
+    }
+    
+    // Where :profile writes folded stacks when it stops; empty skips them.
+    void setFoldedPath(const std::string& path) {
+        foldedPath = path;
+    }
+    
+    // With file commands off, :save and :load are refused, so a session
+    // driven by someone else cannot read or write files as this process.
+    void setFileCommands(bool enabled) {
+        fileCommands = enabled;
+    }
+    
+    void run() {
+        printBanner();
+        std::string line;
+        while (true) {
+            out << ">>> ";
+            if (!std::getline(std::cin, line)) {
+                out << "\n\nAdios!\n\n";
+                break;
+            }
+            if (!evaluateLine(line)) {
+                out << "\nAdios!\n\n";
+                break;
+            }
+        }
+    }
+};
+
+#endif
@@ -2,81 +2,142 @@
 #define SEMANTIC_H
 
 #include "parser.h"
-#include <map>
+#include <algorithm>
+#include <unordered_map>
 
 class SymbolTable {
 private:
-    std::map<std::string, std::string> symbols;
+    const Interner* names;
+    std::vector<Type> types;
+    size_t count;
+    
+    friend class Snapshot;
     
 public:
-    void define(const std::string& name, const std::string& type) {
-        symbols[name] = type;
+    explicit SymbolTable(const Interner& interner) : names(&interner), count(0) {}
+    
+    void define(SymbolId id, Type type) {
+        if (id >= types.size()) types.resize(id + 1, Type::UNDEFINED);
+        if (types[id] == Type::UNDEFINED) count++;
+        types[id] = type;
     }
     
-    bool isDefined(const std::string& name) const {
-        return symbols.find(name) != symbols.end();
+    void undefine(SymbolId id) {
+        if (!isDefined(id)) return;
+        types[id] = Type::UNDEFINED;
+        count--;
     }
     
-    std::string getType(const std::string& name) const {
-        auto it = symbols.find(name);
-        if (it == symbols.end()) {
-            throw std::runtime_error("Error semantico: variable '" + name + "' no definida");
-        }
-        return it->second;
+    bool isDefined(SymbolId id) const {
+        return id < types.size() && types[id] != Type::UNDEFINED;
+    }
+    
+    std::string undefinedError(SymbolId id) const {
+        return "Error semantico: variable '" + std::string(names->name(id)) + "' no definida";
     }
     
-    void print() const {
-        for (const auto& entry : symbols) {
-            std::cout << "  " << entry.first << " : " << entry.second << "\n";
+    Type getType(SymbolId id) const {
+        if (!isDefined(id)) throw std::runtime_error(undefinedError(id));
+        return types[id];
+    }
+    
+    std::vector<SymbolId> getSymbols() const {
+        std::vector<SymbolId> ids;
+        ids.reserve(count);
+        for (SymbolId id = 0; id < types.size(); id++) {
+            if (types[id] != Type::UNDEFINED) ids.push_back(id);
         }
+        std::sort(ids.begin(), ids.end(), [this](SymbolId a, SymbolId b) {
+            return names->name(a) < names->name(b);
+        });
+        return ids;
+    }
+    
+    std::string_view name(SymbolId id) const {
+        return names->name(id);
     }
     
-    const std::map<std::string, std::string>& getSymbols() const {
-        return symbols;
+    size_t size() const {
+        return count;
+    }
+    
+    void print(std::ostream& out = std::cout) const {
+        for (SymbolId id : getSymbols()) {
+            out << "  " << names->name(id) << " : " << typeName(types[id]) << "\n";
+        }
     }
 };
 
 class SemanticAnalyzer {
 private:
+    Interner* symbols;
     SymbolTable symbolTable;
+    NodeId first;
+    std::vector<Type> types;
+    std::unordered_map<NodeId, Type> sharedTypes;
     
-    std::string analyzeExpression(const ASTNode* node) {
-        if (dynamic_cast<const NumberNode*>(node)) {
-            return "number";
-        }
-        if (auto* idNode = dynamic_cast<const IdentifierNode*>(node)) {
-            if (!symbolTable.isDefined(idNode->name)) {
-                throw std::runtime_error("Error semantico: variable '" + 
-                                       idNode->name + "' no definida");
-            }
-            return symbolTable.getType(idNode->name);
-        }
-        if (auto* binOp = dynamic_cast<const BinaryOpNode*>(node)) {
-            std::string leftType = analyzeExpression(binOp->left.get());
-            std::string rightType = analyzeExpression(binOp->right.get());
-            if (leftType != "number" || rightType != "number") {
-                throw std::runtime_error("Error semantico: operacion requiere numeros");
-            }
-            return "number";
-        }
-        throw std::runtime_error("Error semantico: nodo desconocido");
+    Type typeOf(NodeId id) const {
+        return id >= first ? types[id - first] : sharedTypes.at(id);
     }
     
-    void analyzeStatement(const ASTNode* node) {
-        if (auto* assignNode = dynamic_cast<const AssignmentNode*>(node)) {
-            std::string exprType = analyzeExpression(assignNode->expression.get());
-            symbolTable.define(assignNode->variable, exprType);
-        }
-        else if (auto* printNode = dynamic_cast<const PrintNode*>(node)) {
-            analyzeExpression(printNode->expression.get());
+    void keep(NodeId id, const ASTNode& node) {
+        if (node.shared) sharedTypes[id] = types.back();
+    }
+    
+    template <typename Visitor>
+    friend void walk(const Ast&, Visitor&);
+    template <typename Visitor>
+    friend void walkExpression(const Ast&, NodeId, NodeId, Visitor&);
+    friend class Snapshot;
+    
+    void beginStatement(NodeId firstNode) {
+        first = firstNode;
+        types.clear();
+    }
+    
+    void number(NodeId id, const ASTNode& node) {
+        types.push_back(Type::NUMBER);
+        keep(id, node);
+    }
+    
+    void identifier(NodeId id, const ASTNode& node) {
+        types.push_back(symbolTable.getType(node.symbol));
+        keep(id, node);
+    }
+    
+    void binaryOp(NodeId id, const ASTNode& node) {
+        if (typeOf(node.left) != Type::NUMBER || typeOf(node.right) != Type::NUMBER) {
+            throw std::runtime_error("Error semantico: operacion requiere numeros");
         }
+        types.push_back(Type::NUMBER);
+        keep(id, node);
+    }
+    
+    void assignment(NodeId, const ASTNode& node) {
+        symbolTable.define(node.symbol, typeOf(node.left));
     }
     
+    void print(NodeId, const ASTNode&) {}
+    
 public:
-    void analyze(const std::vector<std::unique_ptr<ASTNode>>& statements) {
-        for (const auto& stmt : statements) {
-            analyzeStatement(stmt.get());
-        }
+    explicit SemanticAnalyzer(Interner& interner)
+        : symbols(&interner), symbolTable(interner), first(0) {}
+    
+    void declare(const std::string& name) {
+        symbolTable.define(symbols->intern(name), Type::NUMBER);
+    }
+    
+    void define(SymbolId id, Type type) {
+        symbolTable.define(id, type);
+    }
+    
+    void undefine(SymbolId id) {
+        symbolTable.undefine(id);
+    }
+    
+    void analyze(const Ast& statements) {
+        sharedTypes.clear();
+        walk(statements, *this);
     }
     
     void printSymbolTable() const {
@@ -88,4 +149,4 @@ public:
     }
 };
 
-#endif
\ No newline at end of file
+#endif
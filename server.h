@@ -0,0 +1,300 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "repl.h"
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Serves REPL sessions over a Unix domain socket, one isolated session per
+// connection. A fixed pool of threads waits on a single epoll instance and
+// connections are armed one-shot, so a session is only ever handled by one
+// thread at a time and needs no lock of its own. The protocol is the REPL's:
+// lines in, replies out, with a ">>> " prompt after each line. Sessions never
+// touch the server's files: :save and :load are refused and :profile writes
+// no folded stacks.
+class Server {
+private:
+    static constexpr size_t MAX_LINE_BYTES = 1 << 20;
+    static constexpr size_t MAX_PENDING_OUTPUT = 1 << 20;
+    static constexpr int EVENTS_PER_WAIT = 8;
+    
+    // Collects everything a session writes until it can be sent.
+    class OutputBuffer : public std::streambuf {
+    private:
+        std::string& target;
+        
+    protected:
+        int overflow(int c) override {
+            if (c != EOF) target.push_back(static_cast<char>(c));
+            return c;
+        }
+        
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            target.append(s, static_cast<size_t>(n));
+            return n;
+        }
+        
+    public:
+        explicit OutputBuffer(std::string& output) : target(output) {}
+    };
+    
+    struct Session {
+        int fd;
+        std::string input, output;
+        size_t sent = 0;
+        bool closing = false;
+        OutputBuffer buffer;
+        std::ostream stream;
+        REPL repl;
+        
+        explicit Session(int socket) : fd(socket), buffer(output), stream(&buffer), repl(stream, stream) {
+            repl.setFoldedPath("");
+            repl.setFileCommands(false);
+        }
+    };
+    
+    std::string path;
+    bool bound;
+    int listener, poller, wakeup;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::unordered_map<int, std::unique_ptr<Session>> sessions;
+    
+    void watch(int fd, uint32_t events, void* tag, int operation) {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = tag;
+        if (epoll_ctl(poller, operation, fd, &event) != 0) {
+            throw std::runtime_error(std::string("Error: epoll_ctl: ") + std::strerror(errno));
+        }
+    }
+    
+    void accept() {
+        while (true) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return;
+            }
+            try {
+                auto created = std::make_unique<Session>(fd);
+                Session* session = created.get();
+                session->output = ">>> ";
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    sessions[fd] = std::move(created);
+                }
+                rearm(*session, EPOLL_CTL_ADD);
+            } catch (const std::exception&) {
+                // A connection that cannot be set up is dropped on its own.
+                close(fd);
+            }
+        }
+    }
+    
+    // The descriptor is closed only once its entry is out of the map and
+    // while the lock is held, so accept() cannot reuse the number for a new
+    // session that a late erase would then destroy. The old session, if the
+    // descriptor got one, is destroyed after the lock is released.
+    void close(int fd) {
+        std::unique_ptr<Session> closed;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = sessions.find(fd);
+            if (it != sessions.end()) {
+                closed = std::move(it->second);
+                sessions.erase(it);
+            }
+            ::close(fd);
+        }
+    }
+    
+    // Returns false when the peer is gone.
+    bool receive(Session& session) {
+        char chunk[4096];
+        while (true) {
+            ssize_t n = ::recv(session.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                session.input.append(chunk, static_cast<size_t>(n));
+                if (session.input.size() > MAX_LINE_BYTES) break;
+                continue;
+            }
+            if (n == 0) {
+                // Like getline, a last line without a newline still counts.
+                if (!session.input.empty() && session.input.back() != '\n') session.input.push_back('\n');
+                session.closing = true;
+                return true;
+            }
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        return true;
+    }
+    
+    // Evaluates complete lines until the client stops reading its replies.
+    void evaluate(Session& session) {
+        size_t start = 0;
+        while (session.output.size() - session.sent < MAX_PENDING_OUTPUT) {
+            size_t newline = session.input.find('\n', start);
+            if (newline == std::string::npos) break;
+            std::string line = session.input.substr(start, newline - start);
+            start = newline + 1;
+            if (!session.repl.evaluateLine(line)) {
+                session.output += "\nAdios!\n\n";
+                session.closing = true;
+                session.input.clear();
+                return;
+            }
+            session.output += ">>> ";
+        }
+        session.input.erase(0, start);
+        if (session.input.size() > MAX_LINE_BYTES && session.input.find('\n') == std::string::npos) {
+            session.output += "Error: linea demasiado larga\n";
+            session.closing = true;
+            session.input.clear();
+        }
+    }
+    
+    // Returns false when the peer is gone.
+    bool send(Session& session) {
+        while (session.sent < session.output.size()) {
+            ssize_t n = ::send(session.fd, session.output.data() + session.sent, session.output.size() - session.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                session.sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        if (session.sent == session.output.size()) {
+            session.sent = 0;
+            if (session.output.capacity() > MAX_PENDING_OUTPUT) std::string().swap(session.output);
+            else session.output.clear();
+        }
+        return true;
+    }
+    
+    void rearm(Session& session, int operation = EPOLL_CTL_MOD) {
+        bool pending = session.sent < session.output.size();
+        uint32_t events = EPOLLONESHOT;
+        if (pending) events |= EPOLLOUT;
+        if (!session.closing && session.output.size() - session.sent < MAX_PENDING_OUTPUT) events |= EPOLLIN;
+        watch(session.fd, events, &session, operation);
+    }
+    
+    // A session that fails to grow its buffers or to be rearmed is closed;
+    // the exception must not reach the worker and end every other session.
+    void serve(Session& session, uint32_t events) {
+        try {
+            bool alive = !(events & EPOLLERR);
+            if (alive && (events & (EPOLLIN | EPOLLHUP))) alive = receive(session);
+            while (alive) {
+                evaluate(session);
+                alive = send(session);
+                // Lines left while replies are backed up resume on EPOLLOUT.
+                if (session.sent < session.output.size() || session.input.find('\n') == std::string::npos) break;
+            }
+            if (!alive || (session.closing && session.output.empty() && session.input.empty())) {
+                close(session.fd);
+                return;
+            }
+            rearm(session);
+        } catch (const std::exception&) {
+            close(session.fd);
+        }
+    }
+    
+    void work() {
+        epoll_event events[EVENTS_PER_WAIT];
+        while (true) {
+            int n = epoll_wait(poller, events, EVENTS_PER_WAIT, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                void* tag = events[i].data.ptr;
+                if (tag == &wakeup) return;
+                if (tag == &listener) accept();
+                else serve(*static_cast<Session*>(tag), events[i].events);
+            }
+        }
+    }
+    
+public:
+    explicit Server(const std::string& socketPath) : path(socketPath), bound(false), listener(-1), poller(-1), wakeup(-1) {}
+    
+    ~Server() {
+        stop();
+    }
+    
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+    
+    // A socket file left behind by a server that is no longer running is
+    // replaced; one that still accepts connections is an error.
+    void start(unsigned threads) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Error: ruta de socket demasiado larga '" + path + "'");
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        const sockaddr* raw = reinterpret_cast<const sockaddr*>(&address);
+        
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool running = probe >= 0 && ::connect(probe, raw, sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (running) throw std::runtime_error("Error: ya hay un servidor escuchando en '" + path + "'");
+        ::unlink(path.c_str());
+        
+        listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listener < 0 || ::bind(listener, raw, sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+            throw std::runtime_error("Error: no se pudo escuchar en '" + path + "': " + std::strerror(errno));
+        }
+        bound = true;
+        poller = epoll_create1(EPOLL_CLOEXEC);
+        wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (poller < 0 || wakeup < 0) throw std::runtime_error(std::string("Error: epoll: ") + std::strerror(errno));
+        watch(wakeup, EPOLLIN, &wakeup, EPOLL_CTL_ADD);
+        watch(listener, EPOLLIN | EPOLLEXCLUSIVE, &listener, EPOLL_CTL_ADD);
+        
+        for (unsigned i = 0; i < (threads ? threads : 1); i++) workers.emplace_back(&Server::work, this);
+    }
+    
+    // Wakes every worker, waits for them and drops all open sessions.
+    void stop() {
+        if (wakeup >= 0) {
+            uint64_t one = 1;
+            ssize_t written = ::write(wakeup, &one, sizeof(one));
+            (void)written;
+        }
+        for (std::thread& worker : workers) worker.join();
+        workers.clear();
+        for (auto& entry : sessions) ::close(entry.first);
+        sessions.clear();
+        for (int* fd : {&listener, &poller, &wakeup}) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
+        if (bound) ::unlink(path.c_str());
+        bound = false;
+    }
+    
+    size_t sessionCount() {
+        std::lock_guard<std::mutex> guard(lock);
+        return sessions.size();
+    }
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "semantic.h"
+#include "codegen.h"
+#include "mapped_file.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+#include <unistd.h>
+
+// A REPL session saved as one file: a header, then the interner, the symbol
+// types, the compiled program and the VM frame, each as a 16-byte-aligned
+// section in its in-memory layout. Nothing is parsed or compiled again on
+// load; only the interner's hash table is rebuilt from the names. The
+// bytecode and its locations, which grow with every line the session ran,
+// stay in the mapping like a CachedProgram's: the REPL only runs what later
+// lines add, so the restored code is only written out again by the next
+// save. The state a session keeps changing (symbols, types, the frame) is
+// copied, so restoring costs time in the number of variables and register
+// slots, not in the length of the session.
+class Snapshot {
+private:
+    enum Section : uint32_t {
+        HASH_TABLE, HASHES, NAME_OFFSETS, NAME_TEXT, TYPES, CODE, LOCATIONS,
+        MACHINE_SLOTS, REGISTER_OFFSETS, REGISTER_TEXT, FRAME, SECTIONS
+    };
+    
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t lineNumber;
+        uint32_t variableCount;
+        uint32_t frameRegisters;
+        uint32_t frameVariables;
+        uint32_t reserved;
+        uint64_t instructionCount;
+        uint64_t offsets[SECTIONS];
+        uint64_t counts[SECTIONS];
+    };
+    
+    static constexpr uint32_t VERSION = 2;
+    
+    static constexpr size_t WIDTHS[SECTIONS] = {
+        sizeof(uint32_t), sizeof(uint64_t), sizeof(uint32_t), 1, sizeof(Type), sizeof(Bytecode),
+        sizeof(SourceLocation), sizeof(Slot), sizeof(uint32_t), 1, sizeof(double)
+    };
+    
+    MappedFile file;
+    Header h;
+    
+    explicit Snapshot(const std::string& path) : file(path) {}
+    
+    template <typename T>
+    const T* mapped(Section s) const {
+        return section<T>(file.view(), h, s);
+    }
+    
+    template <typename T>
+    static void write(std::ofstream& out, Header& header, Section section, const T* data, size_t count) {
+        static const char zeros[16] = {};
+        uint64_t position = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>((16 - position % 16) % 16));
+        header.offsets[section] = static_cast<uint64_t>(out.tellp());
+        header.counts[section] = 0;
+        append(out, header, section, data, count);
+    }
+    
+    // Extends the section written last.
+    template <typename T>
+    static void append(std::ofstream& out, Header& header, Section section, const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "seccion no copiable");
+        header.counts[section] += count;
+        out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+    
+    template <typename T>
+    static const T* section(std::string_view image, const Header& header, Section section) {
+        return reinterpret_cast<const T*>(image.data() + header.offsets[section]);
+    }
+    
+    // Offsets into a text section must start at 0, never decrease and end
+    // exactly at its size.
+    static bool validOffsets(const uint32_t* offsets, uint64_t count, uint64_t textSize) {
+        if (count == 0 || offsets[0] != 0) return false;
+        for (uint64_t i = 1; i < count; i++) {
+            if (offsets[i] < offsets[i - 1]) return false;
+        }
+        return offsets[count - 1] == textSize;
+    }
+    
+    static bool validate(std::string_view image, const Header& h) {
+        if (std::memcmp(h.magic, "MCSNAPS", 8) != 0 || h.version != VERSION) return false;
+        for (uint32_t s = 0; s < SECTIONS; s++) {
+            uint64_t offset = h.offsets[s];
+            if (offset % 16 != 0 || offset > image.size() || h.counts[s] > (image.size() - offset) / WIDTHS[s]) return false;
+        }
+        
+        // The hash table is rebuilt from the names on load, so only they count.
+        uint64_t names = h.counts[HASHES];
+        if (h.counts[NAME_OFFSETS] != names + 1 ||
+            !validOffsets(section<uint32_t>(image, h, NAME_OFFSETS), names + 1, h.counts[NAME_TEXT])) {
+            return false;
+        }
+        if (h.counts[TYPES] > names) return false;
+        const Type* types = section<Type>(image, h, TYPES);
+        for (uint64_t i = 0; i < h.counts[TYPES]; i++) {
+            if (types[i] > Type::NUMBER) return false;
+        }
+        
+        uint64_t registers = h.counts[REGISTER_OFFSETS];
+        if (registers == 0 || !validOffsets(section<uint32_t>(image, h, REGISTER_OFFSETS), registers, h.counts[REGISTER_TEXT])) {
+            return false;
+        }
+        registers--;
+        if (registers > INT32_MAX || h.variableCount > names) return false;
+        // CodeGenerator::indexSlots reads K from each name and indexes by it.
+        const uint32_t* registerOffsets = section<uint32_t>(image, h, REGISTER_OFFSETS);
+        const char* registerText = section<char>(image, h, REGISTER_TEXT);
+        for (uint64_t i = 0; i < registers; i++) {
+            const char* name = registerText + registerOffsets[i];
+            const char* end = registerText + registerOffsets[i + 1];
+            if (end - name < 3 || name[0] != '%' || std::string_view("tcsr").find(name[1]) == std::string_view::npos) return false;
+            uint64_t k = 0;
+            std::from_chars_result index = std::from_chars(name + 2, end, k);
+            if (index.ec != std::errc() || index.ptr != end || k >= registers) return false;
+        }
+        int64_t low = -static_cast<int64_t>(registers);
+        // The code is never run again, so only its size is checked.
+        if (h.counts[LOCATIONS] != h.counts[CODE]) return false;
+        const Slot* machine = section<Slot>(image, h, MACHINE_SLOTS);
+        for (uint64_t i = 0; i < h.counts[MACHINE_SLOTS]; i++) {
+            if (machine[i] > 0 || machine[i] < low) return false;
+        }
+        
+        if (h.frameRegisters > registers || h.frameVariables > names) return false;
+        return h.counts[FRAME] == static_cast<uint64_t>(h.frameRegisters) + h.frameVariables;
+    }
+    
+public:
+    // Written to a temporary file first, so an existing snapshot is only
+    // replaced by a complete one; a session restored from `restored` writes
+    // its code after the code still mapped from there.
+    static void save(const std::string& path, const Interner& symbols, const SemanticAnalyzer& semantic,
+                     const CodeGenerator& codegen, const VM& vm, uint32_t lineNumber,
+                     const Snapshot* restored = nullptr) {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "MCSNAPS", 8);
+        header.version = VERSION;
+        header.lineNumber = lineNumber;
+        header.variableCount = codegen.program.variableCount;
+        header.frameRegisters = vm.frame.registers;
+        header.frameVariables = vm.frame.variables;
+        header.instructionCount = codegen.flushed + codegen.instructions.size();
+        
+        const Program& program = codegen.program;
+        std::vector<uint32_t> registerOffsets{0};
+        std::string registerText;
+        for (const std::string& name : program.registerNames) {
+            registerText += name;
+            registerOffsets.push_back(static_cast<uint32_t>(registerText.size()));
+        }
+        
+        std::string temporary = path + ".tmp." + std::to_string(getpid());
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Error: no se pudo crear '" + path + "'");
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write(out, header, HASH_TABLE, symbols.table.data(), symbols.table.size());
+        write(out, header, HASHES, symbols.hashes.data(), symbols.hashes.size());
+        write(out, header, NAME_OFFSETS, symbols.offsets.data(), symbols.offsets.size());
+        write(out, header, NAME_TEXT, symbols.text.data(), symbols.text.size());
+        const std::vector<Type>& types = semantic.symbolTable.types;
+        write(out, header, TYPES, types.data(), types.size());
+        size_t earlier = restored ? static_cast<size_t>(restored->h.counts[CODE]) : 0;
+        write(out, header, CODE, restored ? restored->mapped<Bytecode>(CODE) : nullptr, earlier);
+        append(out, header, CODE, program.code.data(), program.code.size());
+        write(out, header, LOCATIONS, restored ? restored->mapped<SourceLocation>(LOCATIONS) : nullptr, earlier);
+        append(out, header, LOCATIONS, program.locations.data(), program.locations.size());
+        write(out, header, MACHINE_SLOTS, program.machineSlots.data(), program.machineSlots.size());
+        write(out, header, REGISTER_OFFSETS, registerOffsets.data(), registerOffsets.size());
+        write(out, header, REGISTER_TEXT, registerText.data(), registerText.size());
+        write(out, header, FRAME, vm.frame.storage.data(), vm.frame.storage.size());
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Error: no se pudo escribir '" + path + "'");
+        }
+    }
+    
+    // Replaces the whole session state and returns the snapshot, which the
+    // session keeps for its next save. The file is checked before anything
+    // is touched, so a rejected snapshot leaves the session as it was.
+    static std::unique_ptr<Snapshot> load(const std::string& path, Interner& symbols, SemanticAnalyzer& semantic,
+                                          CodeGenerator& codegen, VM& vm, uint32_t& lineNumber) {
+        std::unique_ptr<Snapshot> snapshot(new Snapshot(path));
+        std::string_view image = snapshot->file.view();
+        Header& h = snapshot->h;
+        std::runtime_error invalid("Error: '" + path + "' no es una sesion valida");
+        if (image.size() < sizeof(h)) throw invalid;
+        std::memcpy(&h, image.data(), sizeof(h));
+        if (!validate(image, h)) throw invalid;
+        // Interning the names in order gives each its saved id unless one is
+        // repeated; a table taken from the file could lack an empty slot or
+        // hold an id off its hash chain.
+        Interner interned;
+        const uint32_t* nameOffsets = section<uint32_t>(image, h, NAME_OFFSETS);
+        const char* nameText = section<char>(image, h, NAME_TEXT);
+        for (uint64_t i = 0; i < h.counts[HASHES]; i++) {
+            std::string_view name(nameText + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+            if (interned.intern(name) != i) throw invalid;
+        }
+        
+        auto copy = [&](auto& target, Section s) {
+            using T = typename std::remove_reference<decltype(target)>::type::value_type;
+            const T* data = section<T>(image, h, s);
+            target.assign(data, data + h.counts[s]);
+        };
+        symbols = std::move(interned);
+        
+        SymbolTable& table = semantic.symbolTable;
+        copy(table.types, TYPES);
+        table.count = static_cast<size_t>(std::count_if(table.types.begin(), table.types.end(),
+                                                        [](Type type) { return type != Type::UNDEFINED; }));
+        
+        Program& program = codegen.program;
+        program.code.clear();
+        program.locations.clear();
+        copy(program.machineSlots, MACHINE_SLOTS);
+        program.variableCount = h.variableCount;
+        const uint32_t* offsets = section<uint32_t>(image, h, REGISTER_OFFSETS);
+        const char* text = section<char>(image, h, REGISTER_TEXT);
+        program.registerNames.clear();
+        for (uint64_t i = 0; i + 1 < h.counts[REGISTER_OFFSETS]; i++) {
+            program.registerNames.emplace_back(text + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        codegen.indexSlots();
+        codegen.instructions.clear();
+        codegen.tempCounter = 0;
+        codegen.executed = 0;
+        codegen.flushed = static_cast<size_t>(h.instructionCount);
+        codegen.jitted = JitFunction();
+        codegen.jittedSize = 0;
+        
+        copy(vm.frame.storage, FRAME);
+        vm.frame.registers = h.frameRegisters;
+        vm.frame.variables = h.frameVariables;
+        lineNumber = h.lineNumber;
+        return snapshot;
+    }
+};
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef STATIC_PROGRAM_H
+#define STATIC_PROGRAM_H
+
+// Compiles a program held in a string literal while the C++ code that embeds
+// it is being compiled. Lexing uses the Lexer's character and punctuation
+// tables, parsing follows the statement/expression/term/factor grammar and
+// reading a variable before assigning it is rejected as in SemanticAnalyzer.
+// Any of those errors stops the C++ build at the failing check, and so does
+// a literal that cannot be read here exactly as at run time.
+//
+//   MINICOMPILER_STATIC(Total, "precio, cantidad", "total = precio * cantidad * 1.21; print(total);");
+//   constexpr size_t TOTAL = Total::variable("total");
+//   double variables[Total::VARIABLES] = {2.5, 4};
+//   Total::run(variables);
+//   double total = variables[TOTAL];
+//
+// Inputs take the first slots in the order listed. run() expands to one
+// statement per instruction with every slot and constant known, so the
+// arithmetic inlines into the caller.
+
+#include "lexer.h"
+#include "vm.h"
+#include <array>
+#include <utility>
+
+enum class StaticOp : uint8_t {
+    CONSTANT, MOVE, ADD, SUB, MUL, DIV, PRINT
+};
+
+// Variables at slot >= 0, temporaries at negative slots as in the VM.
+struct StaticInstruction {
+    StaticOp op = StaticOp::MOVE;
+    Slot dst = 0, a = 0, b = 0;
+    double value = 0;
+};
+
+template <size_t N>
+struct StaticCode {
+    std::array<StaticInstruction, N> code{};
+    std::array<std::string_view, N> names{};
+    size_t size = 0;
+    uint32_t variables = 0;
+    uint32_t inputs = 0;
+    uint32_t temps = 0;
+    
+    constexpr bool find(std::string_view name, Slot& slot) const {
+        for (uint32_t i = 0; i < variables; i++) {
+            if (names[i] == name) {
+                slot = static_cast<Slot>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// The literal forms the Lexer accepts: digits with one optional '.'. A
+// literal is read only when its digits fit in 53 bits and it has at most 22
+// decimals (or 22 trailing zeros past that), so one exact power of ten scales
+// it with a single rounding and it reads exactly as parseNumber would read
+// it. Any other literal is rejected rather than rounded differently; the
+// literals parseNumber rejects are among them.
+constexpr double parseStaticNumber(std::string_view text) {
+    constexpr uint64_t EXACT = uint64_t(1) << 53;
+    uint64_t mantissa = 0;
+    int scale = 0;
+    bool fraction = false, exact = true;
+    for (char c : text) {
+        if (c == '.') {
+            if (fraction) throw std::runtime_error("Error lexico: numero no valido");
+            fraction = true;
+            continue;
+        }
+        uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (mantissa <= (EXACT - digit) / 10) {
+            mantissa = mantissa * 10 + digit;
+            if (fraction) scale--;
+        } else if (digit != 0) {
+            exact = false;
+        } else if (!fraction) {
+            scale++;
+        }
+    }
+    while (mantissa != 0 && scale < 0 && mantissa % 10 == 0) {
+        mantissa /= 10;
+        scale++;
+    }
+    while (mantissa != 0 && scale > 22 && mantissa <= EXACT / 10) {
+        mantissa *= 10;
+        scale--;
+    }
+    if (!exact || (mantissa != 0 && (scale > 22 || scale < -22))) {
+        throw std::runtime_error("Error lexico: numero sin lectura exacta en un programa estatico");
+    }
+    double power = 1;
+    for (int k = scale < 0 ? -scale : scale; k > 0; k--) power *= 10;
+    return scale < 0 ? static_cast<double>(mantissa) / power : static_cast<double>(mantissa) * power;
+}
+
+template <size_t N>
+class StaticCompiler {
+private:
+    struct Token {
+        TokenType type = TokenType::END_OF_FILE;
+        std::string_view text;
+    };
+    
+    std::string_view source;
+    size_t position = 0;
+    Token token;
+    StaticCode<N> result;
+    uint32_t temps = 0;
+    std::array<bool, N> defined{};
+    
+    static constexpr uint8_t charClass(char c) {
+        return charTable[static_cast<unsigned char>(c)];
+    }
+    
+    constexpr Token scan() {
+        while (position < source.size() && (charClass(source[position]) & CHAR_SPACE)) position++;
+        if (position >= source.size()) return {TokenType::END_OF_FILE, {}};
+        size_t start = position;
+        uint8_t kind = charClass(source[position]);
+        if (kind & (CHAR_DIGIT | CHAR_IDENT_START)) {
+            uint8_t mask = (kind & CHAR_DIGIT) ? CHAR_NUMBER : CHAR_IDENT;
+            while (position < source.size() && (charClass(source[position]) & mask)) position++;
+            std::string_view word = source.substr(start, position - start);
+            if (kind & CHAR_DIGIT) return {TokenType::NUMBER, word};
+            return {word == "print" ? TokenType::PRINT : TokenType::IDENTIFIER, word};
+        }
+        TokenType type = punctTable[static_cast<unsigned char>(source[position])];
+        if (type == TokenType::UNKNOWN) throw std::runtime_error("Error lexico: caracter no reconocido");
+        position++;
+        return {type, source.substr(start, 1)};
+    }
+    
+    constexpr void advance() {
+        token = scan();
+    }
+    
+    constexpr void expect(TokenType type, const char* message) {
+        if (token.type != type) throw std::runtime_error(message);
+        advance();
+    }
+    
+    constexpr Slot variable(std::string_view name) {
+        Slot slot = 0;
+        if (result.find(name, slot)) return slot;
+        result.names[result.variables] = name;
+        return static_cast<Slot>(result.variables++);
+    }
+    
+    constexpr Slot temp() {
+        Slot slot = registerSlot(temps++);
+        if (temps > result.temps) result.temps = temps;
+        return slot;
+    }
+    
+    constexpr void emit(StaticOp op, Slot dst, Slot a, Slot b = 0, double value = 0) {
+        result.code[result.size++] = {op, dst, a, b, value};
+    }
+    
+    constexpr Slot factor() {
+        if (token.type == TokenType::NUMBER) {
+            Slot dst = temp();
+            emit(StaticOp::CONSTANT, dst, 0, 0, parseStaticNumber(token.text));
+            advance();
+            return dst;
+        }
+        if (token.type == TokenType::IDENTIFIER) {
+            Slot slot = variable(token.text);
+            if (!defined[static_cast<size_t>(slot)]) throw std::runtime_error("Error semantico: variable no definida");
+            advance();
+            return slot;
+        }
+        if (token.type == TokenType::LPAREN) {
+            advance();
+            Slot inner = expression();
+            expect(TokenType::RPAREN, "Error sintaxis: esperaba ')'");
+            return inner;
+        }
+        throw std::runtime_error("Error sintaxis: esperaba un numero, una variable o '('");
+    }
+    
+    constexpr Slot binary(StaticOp op, Slot left, Slot right) {
+        Slot dst = temp();
+        emit(op, dst, left, right);
+        return dst;
+    }
+    
+    constexpr Slot term() {
+        Slot left = factor();
+        while (token.type == TokenType::MULTIPLY || token.type == TokenType::DIVIDE) {
+            StaticOp op = token.type == TokenType::MULTIPLY ? StaticOp::MUL : StaticOp::DIV;
+            advance();
+            left = binary(op, left, factor());
+        }
+        return left;
+    }
+    
+    constexpr Slot expression() {
+        Slot left = term();
+        while (token.type == TokenType::PLUS || token.type == TokenType::MINUS) {
+            StaticOp op = token.type == TokenType::PLUS ? StaticOp::ADD : StaticOp::SUB;
+            advance();
+            left = binary(op, left, term());
+        }
+        return left;
+    }
+    
+    constexpr void statement() {
+        temps = 0;
+        if (token.type == TokenType::PRINT) {
+            advance();
+            expect(TokenType::LPAREN, "Error sintaxis: esperaba '(' despues de print");
+            Slot value = expression();
+            expect(TokenType::RPAREN, "Error sintaxis: esperaba ')'");
+            expect(TokenType::SEMICOLON, "Error sintaxis: esperaba ';'");
+            emit(StaticOp::PRINT, 0, value);
+            return;
+        }
+        if (token.type != TokenType::IDENTIFIER) throw std::runtime_error("Error sintaxis: esperaba una sentencia");
+        std::string_view name = token.text;
+        advance();
+        expect(TokenType::ASSIGN, "Error sintaxis: esperaba '='");
+        Slot value = expression();
+        expect(TokenType::SEMICOLON, "Error sintaxis: esperaba ';'");
+        Slot target = variable(name);
+        defined[static_cast<size_t>(target)] = true;
+        emit(StaticOp::MOVE, target, value);
+    }
+    
+    // Input names, separated by commas and optional spaces.
+    constexpr void declare(std::string_view inputs) {
+        size_t start = 0;
+        while (start < inputs.size()) {
+            size_t end = start;
+            while (end < inputs.size() && inputs[end] != ',') end++;
+            std::string_view name = inputs.substr(start, end - start);
+            while (!name.empty() && (charClass(name.front()) & CHAR_SPACE)) name.remove_prefix(1);
+            while (!name.empty() && (charClass(name.back()) & CHAR_SPACE)) name.remove_suffix(1);
+            if (name.empty() || !(charClass(name[0]) & CHAR_IDENT_START)) throw std::runtime_error("Error: nombre de entrada invalido");
+            Slot slot = 0;
+            if (result.find(name, slot)) throw std::runtime_error("Error: entrada repetida");
+            defined[static_cast<size_t>(variable(name))] = true;
+            start = end + 1;
+        }
+        result.inputs = result.variables;
+    }
+    
+public:
+    constexpr StaticCompiler(std::string_view inputs, std::string_view text) : source(text) {
+        declare(inputs);
+        advance();
+    }
+    
+    constexpr StaticCode<N> compile() {
+        while (token.type != TokenType::END_OF_FILE) statement();
+        return result;
+    }
+};
+
+// Every token adds at most one instruction or one variable, so the source
+// length bounds both.
+template <size_t N>
+constexpr StaticCode<N> compileStatic(std::string_view inputs, std::string_view source) {
+    return StaticCompiler<N>(inputs, source).compile();
+}
+
+template <typename Source>
+class StaticProgram {
+private:
+    static constexpr size_t CAPACITY = Source::inputs().size() + Source::text().size() + 1;
+    static constexpr StaticCode<CAPACITY> program = compileStatic<CAPACITY>(Source::inputs(), Source::text());
+    
+    template <Slot S>
+    static double& at(double* temps, double* variables) {
+        if constexpr (S < 0) return temps[-1 - S];
+        else return variables[S];
+    }
+    
+    template <size_t I>
+    static void step(double* temps, double* variables, PrintCallback print, void* context) {
+        constexpr StaticInstruction inst = program.code[I];
+        if constexpr (inst.op == StaticOp::CONSTANT) {
+            at<inst.dst>(temps, variables) = inst.value;
+        } else if constexpr (inst.op == StaticOp::MOVE) {
+            at<inst.dst>(temps, variables) = at<inst.a>(temps, variables);
+        } else if constexpr (inst.op == StaticOp::ADD) {
+            at<inst.dst>(temps, variables) = at<inst.a>(temps, variables) + at<inst.b>(temps, variables);
+        } else if constexpr (inst.op == StaticOp::SUB) {
+            at<inst.dst>(temps, variables) = at<inst.a>(temps, variables) - at<inst.b>(temps, variables);
+        } else if constexpr (inst.op == StaticOp::MUL) {
+            at<inst.dst>(temps, variables) = at<inst.a>(temps, variables) * at<inst.b>(temps, variables);
+        } else if constexpr (inst.op == StaticOp::DIV) {
+            double divisor = at<inst.b>(temps, variables);
+            if (divisor == 0) throw std::runtime_error("Division por cero");
+            at<inst.dst>(temps, variables) = at<inst.a>(temps, variables) / divisor;
+        } else {
+            print(context, at<inst.a>(temps, variables));
+        }
+    }
+    
+    // With no statements the fold is empty and nothing below is read.
+    template <size_t... I>
+    static void execute([[maybe_unused]] double* variables, [[maybe_unused]] PrintCallback print,
+                        [[maybe_unused]] void* context, std::index_sequence<I...>) {
+        [[maybe_unused]] double temps[program.temps + 1] = {};
+        (step<I>(temps, variables, print, context), ...);
+    }
+    
+public:
+    static constexpr uint32_t VARIABLES = program.variables;
+    static constexpr uint32_t INPUTS = program.inputs;
+    static constexpr size_t INSTRUCTIONS = program.size;
+    
+    // Slot of a variable in the array passed to run(); in a constant
+    // expression an unknown name is a compile error.
+    static constexpr size_t variable(std::string_view name) {
+        Slot slot = 0;
+        if (!program.find(name, slot)) throw std::runtime_error("Error: variable no existe en el programa");
+        return static_cast<size_t>(slot);
+    }
+    
+    // `variables` holds VARIABLES values: the inputs first, then every
+    // variable the program assigns, which run() updates in place.
+    static void run(double* variables, PrintCallback print = printToStdout, void* context = nullptr) {
+        execute(variables, print, context, std::make_index_sequence<program.size>());
+    }
+};
+
+#define MINICOMPILER_STATIC(name, inputList, sourceText) \
+    struct name##Source { \
+        static constexpr std::string_view inputs() { return inputList; } \
+        static constexpr std::string_view text() { return sourceText; } \
+    }; \
+    using name = StaticProgram<name##Source>
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+// Bytes requested from operator new on this thread. It only moves when the
+// executable replaces operator new to bump it (repl.cpp and bench.cpp do).
+inline thread_local uint64_t allocatedBytes = 0;
+
+enum class Phase : uint8_t {
+    LEXER, PARSER, SEMANTIC, CODEGEN, EXECUTE, COUNT
+};
+
+inline const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::LEXER: return "lexer";
+        case Phase::PARSER: return "parser";
+        case Phase::SEMANTIC: return "semantic";
+        case Phase::CODEGEN: return "codegen";
+        case Phase::EXECUTE: return "execute";
+        default: return "?";
+    }
+}
+
+// What each phase counts as its unit of work.
+inline const char* phaseUnit(Phase phase) {
+    switch (phase) {
+        case Phase::LEXER: return "tokens";
+        case Phase::PARSER: return "ast_nodes";
+        case Phase::SEMANTIC: return "symbols_defined";
+        case Phase::CODEGEN: return "instructions_emitted";
+        case Phase::EXECUTE: return "instructions_executed";
+        default: return "items";
+    }
+}
+
+struct PhaseStats {
+    uint64_t calls = 0;
+    uint64_t items = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+};
+
+class Stats {
+private:
+    static constexpr size_t PHASES = static_cast<size_t>(Phase::COUNT);
+    
+    PhaseStats phases[PHASES];
+    
+public:
+    class Scope {
+    private:
+        PhaseStats& phase;
+        std::chrono::steady_clock::time_point start;
+        uint64_t bytes;
+        
+    public:
+        explicit Scope(PhaseStats& stats)
+            : phase(stats), start(std::chrono::steady_clock::now()), bytes(allocatedBytes) {}
+        
+        ~Scope() {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            phase.calls++;
+            phase.nanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            phase.bytes += allocatedBytes - bytes;
+        }
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+    
+    Scope measure(Phase phase) {
+        return Scope(phases[static_cast<size_t>(phase)]);
+    }
+    
+    void count(Phase phase, uint64_t items) {
+        phases[static_cast<size_t>(phase)].items += items;
+    }
+    
+    const PhaseStats& get(Phase phase) const {
+        return phases[static_cast<size_t>(phase)];
+    }
+    
+    void reset() {
+        for (PhaseStats& phase : phases) phase = PhaseStats();
+    }
+    
+    void print(std::ostream& out) const {
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-10s %10s %14s %12s %14s\n", "fase", "llamadas", "elementos", "tiempo(ms)", "bytes");
+        out << line;
+        for (size_t i = 0; i < PHASES; i++) {
+            const PhaseStats& p = phases[i];
+            std::snprintf(line, sizeof(line), "  %-10s %10llu %14llu %12.3f %14llu\n", phaseName(static_cast<Phase>(i)),
+                          static_cast<unsigned long long>(p.calls), static_cast<unsigned long long>(p.items),
+                          p.nanoseconds / 1e6, static_cast<unsigned long long>(p.bytes));
+            out << line;
+        }
+    }
+    
+    void writeJson(std::ostream& out) const {
+        out << "{\"phases\":{";
+        for (size_t i = 0; i < PHASES; i++) {
+            const PhaseStats& p = phases[i];
+            Phase phase = static_cast<Phase>(i);
+            out << (i ? "," : "") << "\"" << phaseName(phase) << "\":{\"calls\":" << p.calls
+                << ",\"" << phaseUnit(phase) << "\":" << p.items << ",\"nanoseconds\":" << p.nanoseconds
+                << ",\"bytes_allocated\":" << p.bytes << "}";
+        }
+        out << "}}\n";
+    }
+};
+
+#endif
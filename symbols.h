@@ -0,0 +1,101 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+struct SourceLocation {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+enum class Type : uint8_t {
+    UNDEFINED, NUMBER
+};
+
+inline const char* typeName(Type type) {
+    return type == Type::NUMBER ? "number" : "undefined";
+}
+
+inline uint64_t fnv1a(std::string_view data) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Maps identifier text to dense SymbolIds. Names are stored back to back in
+// one buffer and looked up through an open-addressing table of ids.
+class Interner {
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    
+    std::vector<uint32_t> table;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> offsets;
+    std::string text;
+    
+    size_t slotFor(std::string_view name, uint64_t h) const {
+        size_t mask = table.size() - 1;
+        size_t i = static_cast<size_t>(h) & mask;
+        while (table[i] != EMPTY) {
+            SymbolId id = table[i];
+            if (hashes[id] == h && this->name(id) == name) return i;
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+    
+    void grow() {
+        std::vector<uint32_t> old(table.empty() ? 64 : table.size() * 2, EMPTY);
+        table.swap(old);
+        size_t mask = table.size() - 1;
+        for (SymbolId id = 0; id < hashes.size(); id++) {
+            size_t i = static_cast<size_t>(hashes[id]) & mask;
+            while (table[i] != EMPTY) i = (i + 1) & mask;
+            table[i] = id;
+        }
+    }
+    
+    friend class Snapshot;
+    
+public:
+    Interner() : offsets{0} {}
+    
+    SymbolId intern(std::string_view name) {
+        if ((hashes.size() + 1) * 2 > table.size()) grow();
+        uint64_t h = fnv1a(name);
+        size_t i = slotFor(name, h);
+        if (table[i] != EMPTY) return table[i];
+        SymbolId id = static_cast<SymbolId>(hashes.size());
+        table[i] = id;
+        hashes.push_back(h);
+        text.append(name);
+        offsets.push_back(static_cast<uint32_t>(text.size()));
+        return id;
+    }
+    
+    bool find(std::string_view name, SymbolId& id) const {
+        if (table.empty()) return false;
+        size_t i = slotFor(name, fnv1a(name));
+        if (table[i] == EMPTY) return false;
+        id = table[i];
+        return true;
+    }
+    
+    std::string_view name(SymbolId id) const {
+        return std::string_view(text).substr(offsets[id], offsets[id + 1] - offsets[id]);
+    }
+    
+    size_t size() const {
+        return hashes.size();
+    }
+};
+
+#endif
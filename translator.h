@@ -0,0 +1,110 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+#include "semantic.h"
+#include "ir.h"
+
+// Builder for BasicParser that checks and emits IR as each construct is
+// reduced, so a chunk is compiled in one pass without building a tree.
+// Every operand is consumed exactly once, by its parent, so it is moved
+// into the instruction; operand ids only live until the end of their
+// statement.
+//
+// Semantic errors are held until the chunk has parsed and definitions only
+// reach the symbol table in check(), so errors come out in the same order,
+// and the table ends in the same state, as with Parser followed by
+// SemanticAnalyzer.
+class Translator {
+private:
+    SemanticAnalyzer* semantic;
+    std::vector<Instruction> code;
+    std::vector<Operand> operands;
+    std::vector<SymbolId> definitions;
+    std::vector<bool> pending;
+    std::string error;
+    uint32_t tempCounter;
+    size_t nodes;
+    
+    NodeId operand(Operand value) {
+        nodes++;
+        operands.push_back(std::move(value));
+        return static_cast<NodeId>(operands.size() - 1);
+    }
+    
+    bool defined(SymbolId id) const {
+        return semantic->getSymbolTable().isDefined(id) || (id < pending.size() && pending[id]);
+    }
+    
+    void endStatement() {
+        nodes++;
+        operands.clear();
+    }
+    
+public:
+    explicit Translator(SemanticAnalyzer& analyzer)
+        : semantic(&analyzer), tempCounter(0), nodes(0) {}
+    
+    void clear() {
+        code.clear();
+        operands.clear();
+        for (SymbolId id : definitions) pending[id] = false;
+        definitions.clear();
+        error.clear();
+        tempCounter = 0;
+        nodes = 0;
+    }
+    
+    NodeId nextId() const {
+        return static_cast<NodeId>(operands.size());
+    }
+    
+    NodeId number(double value, SourceLocation = {}) {
+        return operand(Operand::number(value));
+    }
+    
+    NodeId identifier(SymbolId symbol, SourceLocation = {}) {
+        if (error.empty() && !defined(symbol)) error = semantic->getSymbolTable().undefinedError(symbol);
+        return operand(Operand::variable(symbol));
+    }
+    
+    NodeId binaryOp(char op, NodeId left, NodeId right, SourceLocation location = {}) {
+        Operand temp = Operand::temp(tempCounter++);
+        code.push_back({std::string(1, op), std::move(operands[left]), std::move(operands[right]), temp, location});
+        return operand(temp);
+    }
+    
+    NodeId assignment(SymbolId variable, NodeId expression, NodeId, SourceLocation location = {}) {
+        code.push_back({"=", std::move(operands[expression]), {}, Operand::variable(variable), location});
+        if (error.empty()) {
+            if (variable >= pending.size()) pending.resize(variable + 1, false);
+            if (!pending[variable]) definitions.push_back(variable);
+            pending[variable] = true;
+        }
+        endStatement();
+        return nextId();
+    }
+    
+    NodeId print(NodeId expression, NodeId, SourceLocation location = {}) {
+        code.push_back({"print", std::move(operands[expression]), {}, {}, location});
+        endStatement();
+        return nextId();
+    }
+    
+    // Commits the chunk's definitions made before its first semantic error
+    // and then reports that error.
+    void check() {
+        for (SymbolId id : definitions) semantic->define(id, Type::NUMBER);
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+    
+    std::vector<Instruction>& instructions() {
+        return code;
+    }
+    
+    // Nodes an Ast of the chunk would have held.
+    size_t size() const {
+        return nodes;
+    }
+};
+
+#endif
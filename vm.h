@@ -0,0 +1,265 @@
+#ifndef VM_H
+#define VM_H
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+#include <unistd.h>
+#include "symbols.h"
+
+enum class OpCode : uint8_t {
+    MOVE, ADD, SUB, MUL, DIV, PRINT, LOAD
+};
+
+using Slot = int32_t;
+
+using PrintCallback = void (*)(void* context, double value);
+
+// Printed values use the shortest text that reads back as the same double.
+inline char* formatPrinted(char* out, char* last, double value) {
+    char* end = std::to_chars(out, last - 1, value).ptr;
+    *end++ = '\n';
+    return end;
+}
+
+inline void printToStream(void* context, double value) {
+    char buffer[32];
+    char* end = formatPrinted(buffer, buffer + sizeof(buffer), value);
+    static_cast<std::ostream*>(context)->write(buffer, end - buffer);
+}
+
+inline void printToStdout(void*, double value) {
+    printToStream(&std::cout, value);
+}
+
+// Collects printed values and writes them to a descriptor in large blocks,
+// bypassing iostreams. Nothing else may write to the descriptor in between.
+class PrintBuffer {
+private:
+    static constexpr size_t CAPACITY = 1 << 16;
+    static constexpr size_t LONGEST = 32;
+    
+    int fd;
+    size_t used;
+    std::unique_ptr<char[]> data;
+    
+public:
+    explicit PrintBuffer(int descriptor = STDOUT_FILENO) : fd(descriptor), used(0), data(new char[CAPACITY]) {}
+    
+    ~PrintBuffer() {
+        flush();
+    }
+    
+    PrintBuffer(const PrintBuffer&) = delete;
+    PrintBuffer& operator=(const PrintBuffer&) = delete;
+    
+    void flush() {
+        size_t done = 0;
+        while (done < used) {
+            ssize_t n = ::write(fd, data.get() + done, used - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += static_cast<size_t>(n);
+        }
+        used = 0;
+    }
+    
+    static void print(void* context, double value) {
+        PrintBuffer& buffer = *static_cast<PrintBuffer*>(context);
+        if (buffer.used > CAPACITY - LONGEST) buffer.flush();
+        char* out = buffer.data.get() + buffer.used;
+        buffer.used += static_cast<size_t>(formatPrinted(out, out + LONGEST, value) - out);
+    }
+};
+
+// Variables live at slot == SymbolId and registers (temporaries and
+// literals loaded by LOAD) at negative slots, so both ranges grow without
+// renumbering.
+constexpr Slot registerSlot(uint32_t index) {
+    return -1 - static_cast<Slot>(index);
+}
+
+struct Bytecode {
+    OpCode op;
+    Slot dst, a, b;
+};
+
+// LOAD writes a literal to dst; its bits take the place of a and b, low
+// half first, so the bytecode needs no constant table.
+inline Bytecode loadImmediate(Slot dst, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return {OpCode::LOAD, dst, static_cast<Slot>(static_cast<uint32_t>(bits)), static_cast<Slot>(static_cast<uint32_t>(bits >> 32))};
+}
+
+inline uint64_t immediateBits(const Bytecode& code) {
+    return static_cast<uint32_t>(code.a) | static_cast<uint64_t>(static_cast<uint32_t>(code.b)) << 32;
+}
+
+inline double immediate(const Bytecode& code) {
+    uint64_t bits = immediateBits(code);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Non-owning view of a compiled program, so the VM can run bytecode that
+// lives in a Program or in a mapped cache image alike.
+struct ProgramView {
+    const Bytecode* code;
+    size_t codeSize;
+    uint32_t registerCount;
+    uint32_t variableCount;
+};
+
+struct Program {
+    std::vector<Bytecode> code;
+    std::vector<std::string> registerNames;
+    std::vector<Slot> machineSlots;
+    std::vector<SourceLocation> locations;
+    uint32_t variableCount = 0;
+    
+    uint32_t registerCount() const {
+        return static_cast<uint32_t>(registerNames.size());
+    }
+    
+    ProgramView view() const {
+        return {code.data(), code.size(), registerCount(), variableCount};
+    }
+    
+    void clear() {
+        code.clear();
+        registerNames.clear();
+        machineSlots.clear();
+        locations.clear();
+        variableCount = 0;
+    }
+};
+
+class Frame {
+private:
+    std::vector<double> storage;
+    uint32_t registers, variables;
+    
+    friend class Snapshot;
+    
+public:
+    Frame() : registers(0), variables(0) {}
+    
+    void reserve(uint32_t registerCount, uint32_t variableCount) {
+        if (registerCount <= registers && variableCount <= variables) return;
+        registerCount = std::max(registerCount, registers);
+        variableCount = std::max(variableCount, variables);
+        std::vector<double> grown(static_cast<size_t>(registerCount) + variableCount, 0.0);
+        std::copy(storage.begin(), storage.begin() + registers, grown.begin() + (registerCount - registers));
+        std::copy(storage.begin() + registers, storage.end(), grown.begin() + registerCount);
+        storage.swap(grown);
+        registers = registerCount;
+        variables = variableCount;
+    }
+    
+    void clear() {
+        storage.clear();
+        registers = 0;
+        variables = 0;
+    }
+    
+    double* base() {
+        return storage.data() + registers;
+    }
+    
+    void set(Slot slot, double value) {
+        if (slot < -static_cast<int64_t>(registers) || slot >= static_cast<int64_t>(variables)) return;
+        storage[static_cast<size_t>(registers + static_cast<int64_t>(slot))] = value;
+    }
+    
+    double get(Slot slot) const {
+        if (slot < -static_cast<int64_t>(registers) || slot >= static_cast<int64_t>(variables)) return 0.0;
+        return storage[static_cast<size_t>(registers + static_cast<int64_t>(slot))];
+    }
+    
+    uint32_t variableCount() const {
+        return variables;
+    }
+};
+
+class VM {
+private:
+    Frame frame;
+    PrintCallback print;
+    void* context;
+    
+    friend class Snapshot;
+    
+public:
+    VM() : print(printToStdout), context(nullptr) {}
+    
+    void setPrinter(PrintCallback callback, void* callbackContext) {
+        print = callback;
+        context = callbackContext;
+    }
+    
+    PrintCallback printer() const {
+        return print;
+    }
+    
+    void* printerContext() const {
+        return context;
+    }
+    
+    void reset() {
+        frame.clear();
+    }
+    
+    double* prepare(const ProgramView& program) {
+        frame.reserve(program.registerCount, program.variableCount);
+        return frame.base();
+    }
+    
+    double* prepare(const Program& program) {
+        return prepare(program.view());
+    }
+    
+    void run(const Program& program, size_t from = 0) {
+        run(program.view(), from);
+    }
+    
+    void step(double* m, const Bytecode* pc) const {
+        switch (pc->op) {
+            case OpCode::MOVE: m[pc->dst] = m[pc->a]; break;
+            case OpCode::ADD: m[pc->dst] = m[pc->a] + m[pc->b]; break;
+            case OpCode::SUB: m[pc->dst] = m[pc->a] - m[pc->b]; break;
+            case OpCode::MUL: m[pc->dst] = m[pc->a] * m[pc->b]; break;
+            case OpCode::DIV:
+                if (m[pc->b] == 0) throw std::runtime_error("Division por cero");
+                m[pc->dst] = m[pc->a] / m[pc->b];
+                break;
+            case OpCode::PRINT: print(context, m[pc->a]); break;
+            case OpCode::LOAD: m[pc->dst] = immediate(*pc); break;
+        }
+    }
+    
+    void run(const ProgramView& program, size_t from = 0) {
+        double* m = prepare(program);
+        const Bytecode* pc = program.code + from;
+        const Bytecode* end = program.code + program.codeSize;
+        for (; pc != end; ++pc) step(m, pc);
+    }
+    
+    double get(Slot slot) const {
+        return frame.get(slot);
+    }
+    
+    void set(Slot slot, double value) {
+        frame.set(slot, value);
+    }
+};
+
+#endif
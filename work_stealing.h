@@ -0,0 +1,58 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// One deque per worker. A worker takes from the front of its own deque and,
+// once it runs dry, steals from the back of the others', so the lock it
+// usually takes is only contended while stealing.
+template <typename T>
+class WorkStealingQueue {
+private:
+    struct Lane {
+        std::mutex lock;
+        std::deque<T> items;
+    };
+    
+    std::unique_ptr<Lane[]> lanes;
+    size_t count;
+    
+public:
+    explicit WorkStealingQueue(size_t workers) : lanes(new Lane[workers ? workers : 1]), count(workers ? workers : 1) {}
+    
+    size_t workers() const {
+        return count;
+    }
+    
+    void push(size_t worker, T item) {
+        Lane& lane = lanes[worker % count];
+        std::lock_guard<std::mutex> guard(lane.lock);
+        lane.items.push_back(std::move(item));
+    }
+    
+    bool pop(size_t worker, T& item) {
+        {
+            Lane& own = lanes[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.items.empty()) {
+                item = std::move(own.items.front());
+                own.items.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < count; k++) {
+            Lane& victim = lanes[(worker + k) % count];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.items.empty()) {
+                item = std::move(victim.items.back());
+                victim.items.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif